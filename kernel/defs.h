@@ -8,6 +8,8 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct tgroup;
+struct timer;
 
 // bio.c
 void            binit(void);
@@ -87,8 +89,9 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
-void            proc_mapstacks(pagetable_t);
+int             clone(uint64, uint64, uint64);
+int             join(int);
+uint64          growproc(int);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
@@ -104,27 +107,36 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+void            wakeup_one(void*);
+int             wakeup_n(void*, int);
 void            yield(void);
+void            setrunnable(struct proc*);
+int             resched_pending(void);
+void            rebalance(void);
+int             schedstat(int, uint64);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 void            trace(uint32 mask);
 void            sigalarm(uint64 ticks, void (*handler)(void));
 void            sigreturn(void);
-void            settickets(int);
-void            fcfs_scheduler(struct cpu *c);
-void            round_robin_scheduler(struct cpu *c);
-void            lottery_scheduler(struct cpu *c);
-int             rand(void);
-void            update_ticks(void);
-void            priority_scheduler(struct cpu *c);
+int             settickets(int);
+int             rand(struct cpu*);
 int             dynamic_priority(struct proc *p);
 int             waitx(uint64, uint*, uint*);
 void            update_time(void);
 int            set_priority(int priority, int pid);
-void            mlfq_scheduler(struct cpu *c);
-void            mlfq_init(void);
-void            queue_switch(void);
+void            mlfq_age(void);
+int             mlfqctl(uint64, uint64);
+int             sched_tick(struct proc*);
+int             setscheduler(int, int);
+int             classstat(int, uint64);
+void            edf_replenish(void);
+int             setdeadline(int, int, int, int);
+int             deadlinestat(int, uint64);
+int             setaffinity(int, uint64);
+int             getaffinity(int, uint64);
+int             schedhist(int, uint64);
 // swtch.S
 void            swtch(struct context*, struct context*);
 
@@ -159,8 +171,34 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// timer.c
+void            twinit(void);
+void            timer_add(struct timer*, uint64, void (*)(void*), void*);
+int             timer_cancel(struct timer*);
+void            timer_run(void);
+int             timer_sleep(uint64);
+uint64          timer_next(void);
+
+// futex.c
+int             futex_wait(uint64, int);
+int             futex_wake(uint64, int);
+void            futex_forked(struct tgroup*);
+
+// schedtrace.c
+extern int      trace_on;
+void            schedtraceinit(void);
+void            trace_event(int, int, int, int, int);
+int             schedtrace(int, uint64, int);
+
 // trap.c
 extern uint     ticks;
+extern uint64   tick_cycles;
+void            clockprogram(void);
+void            clockpoke(void);
+void            clockidle(void);
+void            ipi(int);
+void            tlbshootdown(int);
+int             settickrate(int);
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
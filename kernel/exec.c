@@ -31,6 +31,10 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // other threads would lose the page table under them.
+  if(p->tg->ref > 1)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -73,7 +77,8 @@ exec(char *path, char **argv)
   ip = 0;
 
   p = myproc();
-  uint64 oldsz = p->sz;
+  uint64 oldsz = p->tg->sz;
+  uint64 oldtfva = p->tfva;
 
   // Allocate two pages at the next page boundary.
   // Make the first inaccessible as a stack guard.
@@ -123,10 +128,14 @@ exec(char *path, char **argv)
   // Commit to the user image.
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
-  p->sz = sz;
+  p->tg->sz = sz;
+  p->tg->tfslots = 1;
+  p->tfva = TRAPFRAME;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
-  proc_freepagetable(oldpagetable, oldsz);
+  uvmunmap(oldpagetable, TRAMPOLINE, 1, 0);
+  uvmunmap(oldpagetable, oldtfva, 1, 0);
+  uvmfree(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
@@ -652,11 +652,17 @@ static struct inode*
 namex(char *path, int nameiparent, char *name)
 {
   struct inode *ip, *next;
+  struct tgroup *tg;
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
-  else
-    ip = idup(myproc()->cwd);
+  else {
+    // another thread may chdir() meanwhile.
+    tg = myproc()->tg;
+    acquire(&tg->lock);
+    ip = idup(tg->cwd);
+    release(&tg->lock);
+  }
 
   while((path = skipelem(path, name)) != 0){
     ilock(ip);
@@ -0,0 +1,108 @@
+// Futexes: sleeping on a word of user memory.
+//
+// futex_wait() sleeps if the int at a user address still
+// holds the expected value; futex_wake() wakes sleepers on
+// that address. Waiters are keyed by the physical address
+// of the word and sleep on it through the ordinary hashed
+// wait queues. The check and the sleep happen under the
+// thread group lock, and futex_wake() takes the same lock
+// after the caller has stored the new value, so a wakeup
+// cannot fall between them.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+// Return the physical address of the int at uaddr with
+// p->tg->lock held, or 0 if it isn't in user memory. A
+// copy-on-write page is copied first, so that the key is
+// p's own and won't move when a thread writes the word.
+static uint64
+futex_addr(struct proc *p, uint64 uaddr)
+{
+  struct tgroup *tg = p->tg;
+  pte_t *pte;
+
+  if(uaddr % sizeof(int))
+    return 0;
+  for(;;){
+    if(cowfault(p->pagetable, uaddr) < 0)
+      return 0;
+    acquire(&tg->lock);
+    if(uaddr >= tg->sz || (pte = walk(p->pagetable, uaddr, 0)) == 0 ||
+       (*pte & (PTE_V | PTE_U)) != (PTE_V | PTE_U)){
+      release(&tg->lock);
+      return 0;
+    }
+    if((*pte & PTE_COW) == 0)
+      return PTE2PA(*pte) + (uaddr - PGROUNDDOWN(uaddr));
+    // fork() made it copy-on-write again meanwhile.
+    release(&tg->lock);
+  }
+}
+
+// Sleep until futex_wake(uaddr) if *uaddr == val. Return
+// -1 at once if it isn't, or uaddr is bad. Callers must
+// check the word again when it returns.
+int
+futex_wait(uint64 uaddr, int val)
+{
+  struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+  uint64 pa;
+
+  if((pa = futex_addr(p, uaddr)) == 0)
+    return -1;
+  if(*(int *)pa != val){
+    release(&tg->lock);
+    return -1;
+  }
+  p->futex = pa;
+  p->futex_prev = 0;
+  p->futex_next = tg->futexq;
+  if(tg->futexq)
+    tg->futexq->futex_prev = p;
+  tg->futexq = p;
+  sleep((void *)pa, &tg->lock);
+  if(p->futex_prev)
+    p->futex_prev->futex_next = p->futex_next;
+  else
+    tg->futexq = p->futex_next;
+  if(p->futex_next)
+    p->futex_next->futex_prev = p->futex_prev;
+  p->futex = 0;
+  release(&tg->lock);
+  return 0;
+}
+
+// Wake up to n processes sleeping on uaddr, oldest first.
+// Return how many woke, or -1 if uaddr is bad.
+int
+futex_wake(uint64 uaddr, int n)
+{
+  struct proc *p = myproc();
+  uint64 pa;
+
+  if(n < 0 || (pa = futex_addr(p, uaddr)) == 0)
+    return -1;
+  release(&p->tg->lock);
+  return wakeup_n((void *)pa, n);
+}
+
+// fork() has made tg's pages copy-on-write, so the first
+// write to a futex word will move it to a new page, and a
+// futex_wake() would miss the waiters keyed by the old one.
+// Wake them all to look their words up again.
+// tg->lock must be held.
+void
+futex_forked(struct tgroup *tg)
+{
+  struct proc *t;
+
+  for(t = tg->futexq; t; t = t->futex_next)
+    wakeup((void *)t->futex);
+}
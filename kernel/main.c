@@ -20,8 +20,9 @@ main()
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
-    mlfq_init();
     trapinit();      // trap vectors
+    twinit();        // timer wheel
+    schedtraceinit(); // scheduler event trace
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
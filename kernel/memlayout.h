@@ -27,6 +27,7 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid)) // software interrupt pending.
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
 
@@ -62,6 +63,10 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   thread trapframes, one page each (see clone())
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define UTRAPFRAME(i) (TRAPFRAME - (i)*PGSIZE)
+#define UTFSLOT(va) ((TRAPFRAME - (va)) / PGSIZE)
+#define MAXUVA UTRAPFRAME(NTHREAD)
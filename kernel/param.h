@@ -1,5 +1,6 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC      4096  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
+#define NTHREAD      16  // maximum threads per process
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
@@ -11,4 +12,31 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define NWAITQ       64    // wait queues sleeping processes are hashed into
+#define NPIDHASH     1024  // buckets of the pid to proc hash
+#define MTIME_HZ     10000000 // mtime cycles per second in qemu
+#ifndef TICK_HZ
+#define TICK_HZ      10    // clock ticks per second at boot, see settickrate()
+#endif
+#define TICK_HZ_MAX  1000  // fastest clock tick rate
 #define MLFQ_LEVELS  5     // number of priority queues
+#define MLFQ_AGING   30    // default ticks waited on a level before promotion
+#define AGEWHEEL     64    // slots in a cpu's MLFQ aging wheel
+#define MIGRATECOST  1     // ticks a process stays cache-warm after running
+#define BALANCETICKS 4     // ticks between run queue rebalancing
+#define AFFINITYSLACK 1    // extra load a woken process takes to stay on its last cpu
+#define CPUMASK_ALL  ((1UL << NCPU) - 1) // affinity mask of every cpu
+#define NHISTS       3     // latency histograms kept per process and cpu
+#define NHIST        32    // log2 buckets per histogram
+#define TRACE_RING   512   // scheduler events buffered per cpu
+#define STRIDE1      (1 << 20) // stride of a process holding one ticket
+#define FP_SHIFT     8     // fraction bits of PBS fixed-point arithmetic
+#ifndef TIMESLICE
+#define TIMESLICE    0     // max ticks per PBS/FCFS slice, 0 = until it blocks
+#endif
+#define CFS_LATENCY  (MTIME_HZ*4/10) // period in which each CFS process runs once
+#define CFS_MINGRAN  (MTIME_HZ/10)   // shortest CFS slice
+#define CFS_WAKEUP_GRAN (MTIME_HZ/10) // vruntime lead a woken CFS process needs to preempt
+#define CFS_SLEEPER_CREDIT (MTIME_HZ*2/10) // most vruntime a sleeper is credited
+#define EDF_BWONE    (1 << 20) // EDF bandwidth of a process that never stops running
+#define EDF_MAXBW    (EDF_BWONE*95/100) // EDF bandwidth admitted per cpu
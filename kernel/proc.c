@@ -4,12 +4,35 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "schedstat.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
-extern struct que mlfqs[MLFQ_LEVELS];
+// The process table. struct procs are carved out of
+// kalloc'd pages as they are needed and never freed;
+// procs[i] is the one in slot i. Unused ones are kept on a
+// free list, and the others are found by pid in pidhash.
+struct proc *procs[NPROC];
+int nprocs;                     // slots in use
+struct proc *proc_free;         // unused procs, through free_next
+struct proc *pidhash[NPIDHASH]; // procs by pid, through pid_next
+struct tgroup *tg_free;         // unused tgroups, through next
+struct spinlock proc_lock;      // taken after any p->lock
+uint64 kstack_gen;              // kernel stacks mapped so far
+
+// Sleeping processes, hashed by channel, see sleep().
+struct waitq waitq[NWAITQ];
+
+// MLFQ tunables, see mlfqctl().
+int mlfq_aging = MLFQ_AGING;
+int mlfq_quantum[MLFQ_LEVELS];
+
+// The class new processes start in, see setscheduler().
+struct sched_class *sched_default;
+
+// Protects the EDF bandwidth admitted to each cpu.
+struct spinlock dl_lock;
 
 
 struct proc *initproc;
@@ -19,8 +42,16 @@ struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void tgput(struct proc *p);
+static void sib_insert(struct proc **l, struct proc *p);
+static void sib_remove(struct proc **l, struct proc *p);
+static struct sched_class *sched_lookup(int id);
+static void edf_leave(struct proc *p);
+static void resched(struct cpu *c);
+static void sched_rejoin(struct cpu *c, struct proc *p);
 
 extern char trampoline[]; // trampoline.S
+extern pagetable_t kernel_pagetable; // vm.c
 
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
@@ -28,46 +59,170 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void
-proc_mapstacks(pagetable_t kpgtbl)
+// Make room in every run queue for n procs: pages for the
+// heaps, and a Fenwick tree of at least n nodes, doubled as
+// needed. Doubling keeps the old nodes; the only new one
+// that covers old slots is the root, which covers them all.
+// Caller must hold proc_lock.
+static int
+runq_grow(int n)
+{
+  struct runq *rq;
+  struct procheap *h;
+  char *pa;
+  int i, cap;
+
+  for(struct cpu *c = cpus; c < &cpus[NCPU]; c++){
+    rq = &c->rq;
+    struct procheap *heaps[] = { &rq->strideq, &rq->pbsq, &rq->edfq };
+    for(int k = 0; k < NELEM(heaps); k++){
+      h = heaps[k];
+      for(i = 0; i * HEAPPG < n; i++){
+        if(h->pg[i] == 0){
+          if((pa = kalloc()) == 0)
+            return -1;
+          h->pg[i] = (struct proc **)pa;
+        }
+      }
+    }
+    while(rq->tixcap < n){
+      cap = rq->tixcap ? 2 * rq->tixcap : TIXPG;
+      for(i = rq->tixcap / TIXPG; i < cap / TIXPG; i++){
+        if(rq->tix[i] == 0){
+          if((pa = kalloc()) == 0)
+            return -1;
+          memset(pa, 0, PGSIZE);
+          rq->tix[i] = (int *)pa;
+        }
+      }
+      acquire(&rq->lock);
+      if(rq->tixcap)
+        TIX(rq, cap) = TIX(rq, rq->tixcap);
+      rq->tixcap = cap;
+      release(&rq->lock);
+    }
+  }
+  return 0;
+}
+
+// Carve another page into struct procs and put them on
+// the free list. Caller must hold proc_lock.
+static void
+procgrow(void)
 {
   struct proc *p;
+  char *pa;
+  int n;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
+  if(nprocs >= NPROC || (pa = kalloc()) == 0)
+    return;
+  memset(pa, 0, PGSIZE);
+  n = PGSIZE / sizeof(struct proc);
+  if(n > NPROC - nprocs)
+    n = NPROC - nprocs;
+  if(runq_grow(nprocs + n) < 0){
+    kfree(pa);
+    return;
+  }
+  // the lowest slot goes on the free list last, to be used
+  // first.
+  for(p = (struct proc *)pa + n - 1; p >= (struct proc *)pa; p--){
+    initlock(&p->lock, "proc");
+    p->state = UNUSED;
+    p->slot = nprocs + (p - (struct proc *)pa);
+    procs[p->slot] = p;
+    p->free_next = proc_free;
+    proc_free = p;
   }
+  __sync_synchronize();
+  nprocs += n;
 }
 
-// initialize the proc table.
-void
-procinit(void)
+// Carve another page into struct tgroups and put them on
+// the free list. Caller must hold proc_lock.
+static void
+tggrow(void)
+{
+  struct tgroup *tg;
+  char *pa;
+
+  if((pa = kalloc()) == 0)
+    return;
+  memset(pa, 0, PGSIZE);
+  for(tg = (struct tgroup *)pa; tg + 1 <= (struct tgroup *)(pa + PGSIZE); tg++){
+    initlock(&tg->lock, "tgroup");
+    tg->next = tg_free;
+    tg_free = tg;
+  }
+}
+
+// Map a kernel stack for p the first time its slot is
+// used, high in memory below an invalid guard page. It
+// stays mapped for the later processes in the slot.
+// Caller must hold proc_lock.
+static int
+mapkstack(struct proc *p)
+{
+  char *pa;
+
+  if((pa = kalloc()) == 0)
+    return -1;
+  if(mappages(kernel_pagetable, KSTACK(p->slot), PGSIZE, (uint64)pa, PTE_R | PTE_W) != 0){
+    kfree(pa);
+    return -1;
+  }
+  p->kstack = KSTACK(p->slot);
+  // other harts flush their TLBs before running p.
+  sfence_vma();
+  __sync_fetch_and_add(&kstack_gen, 1);
+  return 0;
+}
+
+// Return process pid with p->lock held, or 0 if there is
+// none.
+static struct proc*
+findproc(int pid)
 {
   struct proc *p;
 
-  initlock(&pid_lock, "nextpid");
-  initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->state = UNUSED;
-      p->kstack = KSTACK((int) (p - proc));
+  acquire(&proc_lock);
+  for(p = pidhash[(uint)pid % NPIDHASH]; p && p->pid != pid; p = p->pid_next)
+    ;
+  release(&proc_lock);
+  if(p == 0)
+    return 0;
+  acquire(&p->lock);
+  // procs are never freed, but p may have exited and been
+  // reused meanwhile.
+  if(p->pid != pid){
+    release(&p->lock);
+    return 0;
   }
+  return p;
 }
 
+// initialize the proc table.
 void
-mlfq_init(void)
+procinit(void)
 {
-    for(int i = 0; i < MLFQ_LEVELS; i++){
-        mlfqs[i].head = 0;
-        mlfqs[i].tail = 0;
-        mlfqs[i].size = 0;
-    }
+  struct cpu *c;
+
+  if(sizeof(struct proc) > PGSIZE)
+    panic("procinit: struct proc");
+  initlock(&pid_lock, "nextpid");
+  initlock(&proc_lock, "proc_lock");
+  initlock(&wait_lock, "wait_lock");
+  initlock(&dl_lock, "dl_lock");
+  for(int i = 0; i < NWAITQ; i++)
+    initlock(&waitq[i].lock, "waitq");
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    initlock(&c->rq.lock, "runq");
+    c->rq.cpu = c;
+    c->rand_next = (c - cpus) + 1;
+  }
+  for(int q = 0; q < MLFQ_LEVELS; q++)
+    mlfq_quantum[q] = 1 << q;
+  sched_default = sched_lookup(SCHED_DEFAULT);
 }
 
 // }
@@ -102,6 +257,77 @@ myproc(void)
   return p;
 }
 
+// Charge the time since p's last state change to the
+// counters of its current state. Times come from rdtime,
+// so p is charged for what it actually used rather than
+// for the clock ticks that happened to find it in a state.
+// Caller must hold p->lock.
+static void
+charge(struct proc *p)
+{
+  uint64 now = r_time();
+  uint64 d = now - p->state_time;
+
+  p->state_time = now;
+  switch(p->state){
+  case RUNNING:
+    __sync_fetch_and_add(&p->sched->runtime, d);
+    p->run_time += d;
+    p->rtime += d;
+    p->cq_rtime += d;
+    p->q_time[p->curr_q] += d;
+    break;
+  case SLEEPING:
+    p->sleep_time += d;
+    break;
+  case RUNNABLE:
+    p->ready_time += d;
+    break;
+  default:
+    break;
+  }
+}
+
+// Count a time of d mtime cycles in log2 histogram h of
+// hist[k] and max[k].
+static void
+hist_add(uint hist[NHISTS][NHIST], uint64 max[NHISTS], int k, uint64 d)
+{
+  int b = 0;
+
+  while(b < NHIST - 1 && (d >> (b + 1)) != 0)
+    b++;
+  hist[k][b]++;
+  if(d > max[k])
+    max[k] = d;
+}
+
+// Move p to state s, and count the time it spent in the
+// state it leaves in its and this cpu's histograms.
+// Caller must hold p->lock.
+static void
+setstate(struct proc *p, enum procstate s)
+{
+  struct cpu *c = mycpu();
+  uint64 d;
+  int k;
+
+  charge(p);
+  d = p->state_time - p->state_enter;
+  switch(p->state){
+  case RUNNABLE: k = HIST_WAIT; break;
+  case RUNNING:  k = HIST_SLICE; break;
+  case SLEEPING: k = HIST_SLEEP; break;
+  default:       k = -1; break;
+  }
+  if(k >= 0){
+    hist_add(p->hist, p->hist_max, k, d);
+    hist_add(c->hist, c->hist_max, k, d);
+  }
+  p->state = s;
+  p->state_enter = p->state_time;
+}
+
 int
 allocpid()
 {
@@ -124,19 +350,26 @@ allocproc(void)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
+  acquire(&proc_lock);
+  if(proc_free == 0)
+    procgrow();
+  if((p = proc_free) == 0 || (p->kstack == 0 && mapkstack(p) < 0)){
+    release(&proc_lock);
+    return 0;
   }
-  return 0;
+  proc_free = p->free_next;
+  release(&proc_lock);
 
-found:
+  acquire(&p->lock);
   p->pid = allocpid();
+  acquire(&proc_lock);
+  p->pid_next = pidhash[(uint)p->pid % NPIDHASH];
+  pidhash[(uint)p->pid % NPIDHASH] = p;
+  release(&proc_lock);
   p->state = USED;
+  p->state_time = p->state_enter = r_time();
+  memset(p->hist, 0, sizeof(p->hist));
+  memset(p->hist_max, 0, sizeof(p->hist_max));
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -145,14 +378,6 @@ found:
     return 0;
   }
 
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
-  if(p->pagetable == 0){
-    freeproc(p);
-    release(&p->lock);
-    return 0;
-  }
-
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
@@ -162,10 +387,25 @@ found:
   p->alarm_ticks = 0;
   p->current_ticks = 0;
   p->alarm_handler = 0;
+  p->sched = sched_default;
+  p->rejoin = 0;
+  p->vruntime = 0;
+  p->vlag = 0;
+  p->cfs_slept = 0;
+  p->dl_bw = 0;
+  p->dl_cpu = 0;
+  p->dl_njobs = 0;
+  p->dl_nmiss = 0;
+  p->dl_nthrottle = 0;
+  p->last_cpu = -1;
+  p->cpumask = CPUMASK_ALL;
   p->tickets = 1;
-  p->sleep_ticks = 0;
-  p->run_ticks = 0;
-  p->ready_ticks = 0;
+  p->stride = STRIDE1;
+  p->pass = 0;
+  p->pass_remain = p->stride;
+  p->sleep_time = 0;
+  p->run_time = 0;
+  p->ready_time = 0;
   p->static_priority = 60;
   p->num_scheduled = 0;
   // acquire(&tickslock);
@@ -173,17 +413,17 @@ found:
   // release(&tickslock);
   p->rtime = 0;
   p->etime = 0;
-  p->ctime = ticks;
+  p->ctime = p->state_time;
 
   p->curr_q = 0;
   for(int i = 0; i < MLFQ_LEVELS; i++){
-      p->q_ticks[i] = 0;
+      p->q_time[i] = 0;
   }
+  p->last_run = 0;
+  p->migrations = 0;
+
   p->q_enter_time = ticks;
-  que_push(&mlfqs[0], p);
-  // printf("%d\n",mlfqs[0]->size);
-  p->qued_fl = 1;
-  p->cq_rticks = 0;
+  p->cq_rtime = 0;
 
 
 
@@ -196,16 +436,21 @@ found:
 static void
 freeproc(struct proc *p)
 {
+  struct proc **pp;
+  int pid = p->pid;
+
   if(p->trapframe)
     // decrease_num_ref((uint64)(p->trapframe));
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
+  if(p->tg)
+    tgput(p);
   if(p->trapframe_backup)
     kfree((void*)p->trapframe_backup);
   p->pagetable = 0;
-  p->sz = 0;
+  p->tg = 0;
+  p->tfva = 0;
+  p->thread = 0;
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
@@ -219,20 +464,116 @@ freeproc(struct proc *p)
   p->alarm_handler = 0;
   p->start_ticks = 0;
   p->tickets = 0;
-  p->sleep_ticks = 0;
-  p->run_ticks = 0;
-  p->ready_ticks = 0;
+  p->sleep_time = 0;
+  p->run_time = 0;
+  p->ready_time = 0;
   p->static_priority = 0;
   p->num_scheduled = 0;
 
 
   p->curr_q = 0;
-  p->qued_fl = 0;
   for(int i = 0; i < MLFQ_LEVELS; i++){
-      p->q_ticks[i] = 0;
+      p->q_time[i] = 0;
   }
   p->q_enter_time = 0;
-  p->cq_rticks = 0;
+  p->cq_rtime = 0;
+
+  // take p out of pidhash, unless allocproc() failed before
+  // it got there, and make it free.
+  acquire(&proc_lock);
+  for(pp = &pidhash[(uint)pid % NPIDHASH]; *pp; pp = &(*pp)->pid_next){
+    if(*pp == p){
+      *pp = p->pid_next;
+      break;
+    }
+  }
+  p->pid_next = 0;
+  p->free_next = proc_free;
+  proc_free = p;
+  release(&proc_lock);
+}
+
+// Give p, the first thread of a new process, a thread group
+// of its own with an empty user page table.
+// p->lock must be held.
+static int
+tgalloc(struct proc *p)
+{
+  struct tgroup *tg;
+
+  acquire(&proc_lock);
+  if(tg_free == 0)
+    tggrow();
+  if((tg = tg_free) != 0)
+    tg_free = tg->next;
+  release(&proc_lock);
+  if(tg == 0)
+    return -1;
+
+  if((p->pagetable = proc_pagetable(p)) == 0){
+    acquire(&proc_lock);
+    tg->next = tg_free;
+    tg_free = tg;
+    release(&proc_lock);
+    return -1;
+  }
+  tg->ref = 1;
+  tg->nlive = 1;
+  tg->sz = 0;
+  tg->tfslots = 1;
+  tg->members = p;
+  tg->futexq = 0;
+  tg->next = 0;
+  p->tg = tg;
+  p->tg_next = p->tg_prev = 0;
+  p->tfva = TRAPFRAME;
+  return 0;
+}
+
+// Drop p's reference to its thread group: unmap p's
+// trapframe, and with the last reference free the page
+// table, user memory and the group itself.
+// p->lock must be held.
+static void
+tgput(struct proc *p)
+{
+  struct tgroup *tg = p->tg;
+  int last;
+
+  acquire(&tg->lock);
+  uvmunmap(p->pagetable, p->tfva, 1, 0);
+  tg->tfslots &= ~(1 << UTFSLOT(p->tfva));
+  last = --tg->ref == 0;
+  release(&tg->lock);
+  if(!last)
+    return;
+
+  uvmunmap(p->pagetable, TRAMPOLINE, 1, 0);
+  uvmfree(p->pagetable, tg->sz);
+  acquire(&proc_lock);
+  tg->next = tg_free;
+  tg_free = tg;
+  release(&proc_lock);
+}
+
+// Make the other harts running p's threads flush stale
+// translations of the shared page table, and wait until they
+// have. A hart that starts running one of them later fences
+// on its way to user space. The caller must hold no spinlock,
+// since a hart spinning for it would never flush.
+static void
+tgshootdown(struct proc *p)
+{
+  struct cpu *c;
+  struct proc *q;
+
+  // order the page table updates before reading c->proc.
+  __sync_synchronize();
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    q = c->proc;
+    if(q && q != p && q->tg == p->tg)
+      tlbshootdown(c - cpus);
+  }
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -300,42 +641,100 @@ userinit(void)
 
   p = allocproc();
   initproc = p;
+  if(tgalloc(p) < 0)
+    panic("userinit");
 
   // allocate one user page and copy initcode's instructions
   // and data into it.
   uvmfirst(p->pagetable, initcode, sizeof(initcode));
-  p->sz = PGSIZE;
+  p->tg->sz = PGSIZE;
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
   p->trapframe->sp = PGSIZE;  // user stack pointer
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
-  p->cwd = namei("/");
+  p->tg->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&p->lock);
 }
 
+static void shrinkproc(struct proc *p, uint64 sz);
+
 // Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
-int
+// Return the old size on success, -1 on failure.
+uint64
 growproc(int n)
 {
-  uint64 sz;
+  uint64 sz, oldsz;
   struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
 
-  sz = p->sz;
+  // threads may call sbrk() at the same time.
+  acquire(&tg->lock);
+  oldsz = sz = tg->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+    if(sz + n > MAXUVA || (sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+      release(&tg->lock);
       return -1;
     }
-  } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    tg->sz = sz;
   }
-  p->sz = sz;
-  return 0;
+  release(&tg->lock);
+  if(n < 0 && oldsz + n < oldsz)
+    shrinkproc(p, oldsz + n);
+  return oldsz;
+}
+
+// Shrink p's memory to sz bytes. Other harts may still have
+// the pages in their TLBs, so unmap them a batch at a time,
+// and free each batch only after those harts have flushed.
+static void
+shrinkproc(struct proc *p, uint64 sz)
+{
+  struct tgroup *tg = p->tg;
+  uint64 pa[64], va;
+  pte_t *pte;
+  int i, n;
+
+  do {
+    acquire(&tg->lock);
+    va = PGROUNDUP(tg->sz);
+    for(n = 0; n < NELEM(pa) && va > PGROUNDUP(sz); n++){
+      va -= PGSIZE;
+      if((pte = walk(p->pagetable, va, 0)) == 0 || (*pte & PTE_V) == 0)
+        panic("shrinkproc");
+      pa[n] = PTE2PA(*pte);
+      *pte = 0;
+    }
+    if(tg->sz > sz)
+      tg->sz = va > PGROUNDUP(sz) ? va : sz;
+    release(&tg->lock);
+
+    if(n > 0)
+      tgshootdown(p);
+    for(i = 0; i < n; i++)
+      kfree((void*)pa[i]);
+  } while(n == NELEM(pa));
+}
+
+// Start np with the calling process's tracing and
+// scheduling settings.
+static void
+inherit(struct proc *np, struct proc *p)
+{
+  np->mask = p->mask;
+  // EDF bandwidth is admitted per process, not inherited.
+  np->sched = p->sched->id == SCHED_EDF ? sched_default : p->sched;
+  np->tickets = p->tickets;
+  np->stride = p->stride;
+  np->pass_remain = np->stride;
+  // the child starts out sharing the parent's pages, so
+  // the parent's cpu has them cached.
+  np->last_cpu = p->last_cpu;
+  np->cpumask = p->cpumask;
 }
 
 // Create a new process, copying the parent.
@@ -351,27 +750,101 @@ fork(void)
   if((np = allocproc()) == 0){
     return -1;
   }
+  if(tgalloc(np) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
 
-  // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  // Copy user memory from parent to child. uvmcopy() makes
+  // the parent's pages copy-on-write, under its threads.
+  acquire(&p->tg->lock);
+  if(uvmcopy(p->pagetable, np->pagetable, p->tg->sz) < 0){
+    release(&p->tg->lock);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
-  np->sz = p->sz;
-  np->mask = p->mask;
-  np->tickets = p->tickets;
+  np->tg->sz = p->tg->sz;
+
+  // increment reference counts on open file descriptors.
+  for(i = 0; i < NOFILE; i++)
+    if(p->tg->ofile[i])
+      np->tg->ofile[i] = filedup(p->tg->ofile[i]);
+  np->tg->cwd = idup(p->tg->cwd);
+  futex_forked(p->tg);
+  release(&p->tg->lock);
+
+  inherit(np, p);
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
 
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // increment reference counts on open file descriptors.
-  for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  // p's other threads must stop writing through the entries
+  // uvmcopy() made copy-on-write before np can see the pages.
+  tgshootdown(p);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  sib_insert(&p->children, np);
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a thread of the calling process: a process that
+// shares its page table, open files and current directory,
+// and starts at fn(arg) with sp set to stack. Return the
+// thread's pid, for join().
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int i, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+
+  // map np's trapframe at a free slot below TRAPFRAME.
+  acquire(&tg->lock);
+  for(i = 0; i < NTHREAD && (tg->tfslots >> i) & 1; i++)
+    ;
+  if(i == NTHREAD || mappages(p->pagetable, UTRAPFRAME(i), PGSIZE,
+                              (uint64)np->trapframe, PTE_R | PTE_W) < 0){
+    release(&tg->lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  tg->tfslots |= 1 << i;
+  tg->ref++;
+  tg->nlive++;
+  release(&tg->lock);
+  np->tg = tg;
+  np->pagetable = p->pagetable;
+  np->tfva = UTRAPFRAME(i);
+
+  inherit(np, p);
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->trapframe->ra = 0;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
@@ -381,30 +854,118 @@ fork(void)
 
   acquire(&wait_lock);
   np->parent = p;
+  np->thread = 1;
+  sib_insert(&p->threads, np);
+  np->tg_prev = 0;
+  np->tg_next = tg->members;
+  if(tg->members)
+    tg->members->tg_prev = np;
+  tg->members = np;
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
 }
 
-// Pass p's abandoned children to init.
-// Caller must hold wait_lock.
-void
-reparent(struct proc *p)
+// Wait for thread tid of the calling process to exit, or
+// for any of them if tid is 0, and return its pid.
+// Return -1 if there is no such thread.
+int
+join(int tid)
 {
-  struct proc *pp;
+  struct proc *t;
+  int pid;
+  struct proc *p = myproc();
+
+  acquire(&wait_lock);
+
+  for(;;){
+    for(t = p->tzombies; t && tid && t->pid != tid; t = t->sib_next)
+      ;
+    if(t){
+      // make sure the thread isn't still in exit() or swtch().
+      acquire(&t->lock);
+      pid = t->pid;
+      sib_remove(&p->tzombies, t);
+      freeproc(t);
+      release(&t->lock);
+      release(&wait_lock);
+      return pid;
+    }
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
+    for(t = p->threads; t && tid && t->pid != tid; t = t->sib_next)
+      ;
+    if(t == 0 || killed(p)){
+      release(&wait_lock);
+      return -1;
     }
+
+    // Wait for a thread to exit.
+    sleep(p, &wait_lock);  //DOC: wait-sleep
+  }
+}
+
+// Each process keeps its children on two lists, linked
+// through sib_next and sib_prev: the live ones, and the
+// zombies, which exit() moves over. wait() takes the first
+// zombie and never looks at the live ones. All of it is
+// protected by wait_lock.
+
+// Link p at the head of list l.
+static void
+sib_insert(struct proc **l, struct proc *p)
+{
+  p->sib_prev = 0;
+  p->sib_next = *l;
+  if(*l)
+    (*l)->sib_prev = p;
+  *l = p;
+}
+
+// Unlink p from list l.
+static void
+sib_remove(struct proc **l, struct proc *p)
+{
+  if(p->sib_prev)
+    p->sib_prev->sib_next = p->sib_next;
+  else
+    *l = p->sib_next;
+  if(p->sib_next)
+    p->sib_next->sib_prev = p->sib_prev;
+  p->sib_next = p->sib_prev = 0;
+}
+
+// Move every proc on list *from to init's list *to.
+static void
+sib_move(struct proc **from, struct proc **to)
+{
+  struct proc *pp;
+
+  while((pp = *from) != 0){
+    sib_remove(from, pp);
+    pp->parent = initproc;
+    pp->thread = 0;
+    sib_insert(to, pp);
   }
 }
 
+// Pass p's abandoned children and threads to init, which
+// waits for the threads like children.
+// Caller must hold wait_lock.
+void
+reparent(struct proc *p)
+{
+  if(p->zombies || p->tzombies)
+    wakeup(initproc);
+  sib_move(&p->zombies, &initproc->zombies);
+  sib_move(&p->tzombies, &initproc->zombies);
+  sib_move(&p->children, &initproc->children);
+  sib_move(&p->threads, &initproc->children);
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait().
@@ -413,35 +974,76 @@ exit(int status)
 {
   struct proc *p = myproc();
 
+  struct tgroup *tg = p->tg;
+  struct proc *t;
+  int last;
+
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
+  // The last thread out closes the files.
+  acquire(&tg->lock);
+  last = --tg->nlive == 0;
+  release(&tg->lock);
+  if(last){
+    // Close all open files.
+    for(int fd = 0; fd < NOFILE; fd++){
+      if(tg->ofile[fd]){
+        struct file *f = tg->ofile[fd];
+        fileclose(f);
+        tg->ofile[fd] = 0;
+      }
     }
-  }
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+    begin_op();
+    iput(tg->cwd);
+    end_op();
+    tg->cwd = 0;
+  }
 
   acquire(&wait_lock);
 
-  // Give any children to init.
+  if(p->tg_prev)
+    p->tg_prev->tg_next = p->tg_next;
+  else
+    tg->members = p->tg_next;
+  if(p->tg_next)
+    p->tg_next->tg_prev = p->tg_prev;
+  p->tg_next = p->tg_prev = 0;
+
+  // A process's first thread takes all the others down with
+  // it, whichever thread created them.
+  if(p->tfva == TRAPFRAME){
+    for(t = tg->members; t; t = t->tg_next){
+      acquire(&t->lock);
+      t->killed = 1;
+      if(t->state == SLEEPING)
+        setrunnable(t);
+      release(&t->lock);
+    }
+  }
+
+  // Give any children and threads to init.
   reparent(p);
 
-  // Parent might be sleeping in wait().
+  // Parent might be sleeping in wait() or join().
+  if(p->thread){
+    sib_remove(&p->parent->threads, p);
+    sib_insert(&p->parent->tzombies, p);
+  } else {
+    sib_remove(&p->parent->children, p);
+    sib_insert(&p->parent->zombies, p);
+  }
   wakeup(p->parent);
 
   acquire(&p->lock);
   p->xstate = status;
-  p->state = ZOMBIE;
-  p->etime = ticks;
+  if(p->sched->id == SCHED_EDF){
+    edf_leave(p);
+    p->sched = sched_default;
+  }
+  setstate(p, ZOMBIE);
+  p->etime = p->state_time;
 
 
   release(&wait_lock);
@@ -457,40 +1059,31 @@ int
 wait(uint64 addr)
 {
   struct proc *pp;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&pp->lock);
-
-        havekids = 1;
-        if(pp->state == ZOMBIE){
-          // Found one.
-          pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(pp);
-          release(&pp->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    if((pp = p->zombies) != 0){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&pp->lock);
+      pid = pp->pid;
+      if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+                              sizeof(pp->xstate)) < 0) {
         release(&pp->lock);
+        release(&wait_lock);
+        return -1;
       }
+      sib_remove(&p->zombies, pp);
+      freeproc(pp);
+      release(&pp->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || killed(p)){
+    if(p->children == 0 || killed(p)){
       release(&wait_lock);
       return -1;
     }
@@ -503,42 +1096,33 @@ int
 waitx(uint64 addr, uint* wtime, uint* rtime)
 {
   struct proc *np;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          *rtime = np->rtime;
-          *wtime = np->etime - np->ctime - np->rtime;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
-          release(&np->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    if((np = p->zombies) != 0){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      pid = np->pid;
+      *rtime = np->rtime / tick_cycles;
+      *wtime = (np->etime - np->ctime - np->rtime) / tick_cycles;
+      if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                              sizeof(np->xstate)) < 0) {
         release(&np->lock);
+        release(&wait_lock);
+        return -1;
       }
+      sib_remove(&p->zombies, np);
+      freeproc(np);
+      release(&np->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || p->killed){
+    if(p->children == 0 || p->killed){
       release(&wait_lock);
       return -1;
     }
@@ -548,401 +1132,1514 @@ waitx(uint64 addr, uint* wtime, uint* rtime)
   }
 }
 
-// void
-// update_time()
-// {
-//   struct proc* p;
-//   for (p = proc; p < &proc[NPROC]; p++) {
-//     acquire(&p->lock);
-//     if (p->state == RUNNING) {
-//       p->rtime++;
-//     }
-//     release(&p->lock);
-//   }
-// }
+// Run queues.
+//
+// A process is on exactly one cpu's run queue from the moment
+// it becomes RUNNABLE until a scheduler takes it off to run it.
+// Lock order: p->lock, then rq->lock. A scheduler takes a
+// process off its queue holding only rq->lock and locks the
+// process afterwards; that is safe because nothing but a
+// scheduler moves a RUNNABLE process to RUNNING.
+//
+// Every queued process is on rq->all, oldest first, which is
+// what load balancing takes from. It is also kept in the
+// structure of its scheduling class, p->sched, which decides
+// the order processes run in; see sched_classes[] below.
+
+// Class lists are linked through p->cl_next and p->cl_prev.
+
+// Link p into l after prev, or at the head if prev is 0.
+static void
+plist_insert(struct plist *l, struct proc *prev, struct proc *p)
+{
+  p->cl_prev = prev;
+  if(prev){
+    p->cl_next = prev->cl_next;
+    prev->cl_next = p;
+  } else {
+    p->cl_next = l->head;
+    l->head = p;
+  }
+  if(p->cl_next)
+    p->cl_next->cl_prev = p;
+  else
+    l->tail = p;
+}
 
-void update_ticks(void){
-  struct proc *p;
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->state == RUNNING){
-      p->run_ticks++;
-      p->rtime++;
+static void
+plist_remove(struct plist *l, struct proc *p)
+{
+  if(p->cl_prev)
+    p->cl_prev->cl_next = p->cl_next;
+  else
+    l->head = p->cl_next;
+  if(p->cl_next)
+    p->cl_next->cl_prev = p->cl_prev;
+  else
+    l->tail = p->cl_prev;
+  p->cl_next = 0;
+  p->cl_prev = 0;
+}
 
-      p->cq_rticks++;
-      p->q_ticks[p->curr_q]++;
+// The tickets of the lottery processes on a run queue are
+// kept in a Fenwick tree indexed by proc slot, so the lottery
+// draws its winner in O(log nprocs) and entering or leaving
+// the queue updates the total incrementally.
 
+// Add n tickets to slot.
+// Caller must hold rq->lock.
+static void
+tix_add(struct runq *rq, int slot, int n)
+{
+  rq->ntickets += n;
+  for(int i = slot + 1; i <= rq->tixcap; i += i & -i)
+    TIX(rq, i) += n;
+}
+
+// Return the slot holding ticket t, 0 <= t < rq->ntickets.
+// Caller must hold rq->lock.
+static int
+tix_find(struct runq *rq, int t)
+{
+  int pos = 0, step;
+
+  for(step = rq->tixcap; step > 0; step /= 2){
+    if(pos + step <= rq->tixcap && TIX(rq, pos + step) <= t){
+      pos += step;
+      t -= TIX(rq, pos);
     }
-    else if(p->state == SLEEPING){
-      p->sleep_ticks++;
-    }
-    else if(p->state == RUNNABLE){
-      p->ready_ticks++;
-    }
-    release(&p->lock);
-    // if(p->pid != 0 && p->pid != 1 && p->pid != 2){
-    //   printf("%d %d %d\n", p->pid, p->curr_q, ticks);
-    // }
   }
+  return pos;
+}
 
+// Binary min-heaps of processes, ordered by less().
+// Caller must hold the lock of the run queue the heap
+// belongs to.
 
-  queue_switch();
+static struct proc*
+heap_min(struct procheap *h)
+{
+  return h->n > 0 ? HEAP(h, 0) : 0;
 }
 
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
-//  - swtch to start running that process.
-//  - eventually that process transfers control
-//    via swtch back to the scheduler.
-void
-scheduler(void)
+static void
+heap_swap(struct procheap *h, int i, int j)
 {
-  // struct proc *p;
-  struct cpu *c = mycpu();
+  struct proc *t = HEAP(h, i);
 
-  c->proc = 0;
+  HEAP(h, i) = HEAP(h, j);
+  HEAP(h, j) = t;
+  HEAP(h, i)->heap_idx = i;
+  HEAP(h, j)->heap_idx = j;
+}
+
+static void
+heap_up(struct procheap *h, int i, int (*less)(struct proc*, struct proc*))
+{
+  while(i > 0 && less(HEAP(h, i), HEAP(h, (i-1)/2))){
+    heap_swap(h, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static void
+heap_down(struct procheap *h, int i, int (*less)(struct proc*, struct proc*))
+{
   for(;;){
-    // Avoid deadlock by ensuring that devices can interrupt.
-    intr_on();
-    #ifdef LBS
-    lottery_scheduler(c);
-    #endif
-    #ifdef RR
-    round_robin_scheduler(c);
-    #endif
-    #ifdef FCFS
-    fcfs_scheduler(c);
-    #endif
-    #ifdef PBS
-    priority_scheduler(c);
-    #endif
-    #ifdef MLFQ
-    mlfq_scheduler(c);
-    #endif
-    // for(p = proc; p < &proc[NPROC]; p++) {
-    //   acquire(&p->lock);
-    //   if(p->state == RUNNABLE) {
-    //     // Switch to chosen process.  It is the process's job
-    //     // to release its lock and then reacquire it
-    //     // before jumping back to us.
-    //     p->state = RUNNING;
-    //     c->proc = p;
-        // swtch(&c->context, &p->context);
-
-    //     // Process is done running for now.
-    //     // It should have changed its p->state before coming back.
-    //     c->proc = 0;
-    //   }
-    //   release(&p->lock);
-    // }
+    int m = i, l = 2*i + 1, r = 2*i + 2;
+    if(l < h->n && less(HEAP(h, l), HEAP(h, m)))
+      m = l;
+    if(r < h->n && less(HEAP(h, r), HEAP(h, m)))
+      m = r;
+    if(m == i)
+      break;
+    heap_swap(h, i, m);
+    i = m;
   }
 }
 
-void
-fcfs_scheduler(struct cpu *c)
+static void
+heap_push(struct procheap *h, struct proc *p, int (*less)(struct proc*, struct proc*))
 {
-  struct proc *p;
-  struct proc *min_proc = 0;
-  uint64 min_sticks = -1;
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == RUNNABLE) {
-      if(min_sticks == -1) {
-        min_sticks = p->start_ticks;
-        min_proc = p;
-        // continue;
-      }
-      if(p->start_ticks < min_sticks) {
-        release(&min_proc->lock);
-        min_proc = p;
-        min_sticks = p->start_ticks;
-        // continue;
-      }
-    }
-    if(min_proc!= p){
-      release(&p->lock);
-    }
+  if(h->n >= NPROC || h->pg[h->n / HEAPPG] == 0)
+    panic("heap_push");
+  p->heap_idx = h->n;
+  HEAP(h, h->n) = p;
+  h->n++;
+  heap_up(h, p->heap_idx, less);
+}
+
+static void
+heap_remove(struct procheap *h, struct proc *p, int (*less)(struct proc*, struct proc*))
+{
+  int i = p->heap_idx;
+
+  if(i < 0 || i >= h->n || HEAP(h, i) != p)
+    panic("heap_remove");
+  h->n--;
+  if(i != h->n){
+    HEAP(h, i) = HEAP(h, h->n);
+    HEAP(h, i)->heap_idx = i;
+    heap_down(h, i, less);
+    heap_up(h, i, less);
+  }
+  p->heap_idx = -1;
+}
+
+// Restore heap order after p's key changed.
+static void
+heap_fix(struct procheap *h, struct proc *p, int (*less)(struct proc*, struct proc*))
+{
+  heap_down(h, p->heap_idx, less);
+  heap_up(h, p->heap_idx, less);
+}
+
+// Round robin: queued processes run in arrival order.
+
+static void
+rr_enqueue(struct runq *rq, struct proc *p, int join)
+{
+  plist_insert(&rq->rr, rq->rr.tail, p);
+}
+
+static void
+rr_dequeue(struct runq *rq, struct proc *p, int leave)
+{
+  plist_remove(&rq->rr, p);
+}
+
+static struct proc*
+rr_pick(struct runq *rq)
+{
+  return rq->rr.head;
+}
+
+// RR, LBS and stride scheduling preempt on every tick.
+static int
+tick_always(struct proc *p)
+{
+  return 1;
+}
+
+// PBS and FCFS run a process until it blocks, or for
+// TIMESLICE ticks if that is set.
+static int
+tick_slice(struct proc *p)
+{
+  return TIMESLICE > 0 && ++p->slice_ticks >= TIMESLICE;
+}
+
+// FCFS: the list is kept sorted by creation time, so the
+// earliest process is always at its head. A process whose
+// bounded slice ran out goes to the back.
+
+static void
+fcfs_enqueue(struct runq *rq, struct proc *p, int join)
+{
+  struct proc *prev = rq->fcfs.tail;
+
+  while(join && prev && prev->start_ticks > p->start_ticks)
+    prev = prev->cl_prev;
+  plist_insert(&rq->fcfs, prev, p);
+}
+
+static void
+fcfs_dequeue(struct runq *rq, struct proc *p, int leave)
+{
+  plist_remove(&rq->fcfs, p);
+}
+
+static struct proc*
+fcfs_pick(struct runq *rq)
+{
+  return rq->fcfs.head;
+}
+
+// Per-cpu pseudo random numbers, so that harts
+// drawing lotteries don't share one generator.
+int
+rand(struct cpu *c)
+{
+  c->rand_next = c->rand_next * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)(c->rand_next >> 33);
+}
+
+// Lottery: draw a winning ticket among the queued processes.
+
+static void
+lbs_enqueue(struct runq *rq, struct proc *p, int join)
+{
+  p->rq_tickets = p->tickets;
+  tix_add(rq, p->slot, p->rq_tickets);
+}
+
+static void
+lbs_dequeue(struct runq *rq, struct proc *p, int leave)
+{
+  tix_add(rq, p->slot, -p->rq_tickets);
+  p->rq_tickets = 0;
+}
+
+static struct proc*
+lbs_pick(struct runq *rq)
+{
+  if(rq->ntickets <= 0)
+    return 0;
+  return procs[tix_find(rq, rand(rq->cpu) % rq->ntickets)];
+}
+
+// Dynamic priority for PBS: static priority shifted by up to
+// 5 either way by niceness, 10 * sleep_time/(sleep_time +
+// run_time) since last scheduled. The ratio is kept in
+// FP_SHIFT-bit fixed point so that it is not truncated to 0.
+int dynamic_priority(struct proc *p)
+{
+  int niceness;
+  uint64 run = p->run_time;
 
+  // the current run has not been charged yet.
+  if(p->state == RUNNING)
+    run += r_time() - p->state_time;
+  if(((p->sleep_time + run) == 0)){
+    niceness = 5 << FP_SHIFT;
   }
-  if(min_sticks != -1 ){
-    // acquire(&min_proc->lock);
-    if(min_proc->state != RUNNABLE) {
-      release(&min_proc->lock);
-      return;
+  else{
+    niceness = ((p->sleep_time * 10) << FP_SHIFT) / (p->sleep_time + run);
+  }
+
+  // round to the nearest integer priority.
+  int DP = ((p->static_priority + 5) << FP_SHIFT) - niceness;
+  DP = (DP + (1 << (FP_SHIFT - 1))) >> FP_SHIFT;
+  if(DP > 100){
+    DP = 100;
+  }
+  if(DP < 0){
+    DP = 0;
+  }
+  return DP;
+}
+
+// PBS: run the queued process with the lowest dynamic
+// priority value, breaking ties on fewer times scheduled
+// and then on earlier creation.
+static int
+pbs_less(struct proc *a, struct proc *b)
+{
+  if(a->pbs_dp != b->pbs_dp)
+    return a->pbs_dp < b->pbs_dp;
+  if(a->num_scheduled != b->num_scheduled)
+    return a->num_scheduled < b->num_scheduled;
+  return a->start_ticks < b->start_ticks;
+}
+
+#ifdef PREEMPT
+// Ask rq's cpu to reschedule if the best PBS process queued
+// on it beats the PBS process it is running. The running
+// process is looked at without its lock; at worst the cpu
+// reschedules once for nothing.
+// Caller must hold rq->lock.
+static void
+pbs_check_preempt(struct runq *rq)
+{
+  struct proc *best, *curr;
+
+  best = heap_min(&rq->pbsq);
+  curr = rq->cpu->proc;
+  if(best && curr && curr->sched == best->sched &&
+     best->pbs_dp < dynamic_priority(curr))
+    resched(rq->cpu);
+}
+#endif
+
+static void
+pbs_enqueue(struct runq *rq, struct proc *p, int join)
+{
+  // sleep_time and run_time only change while p is
+  // sleeping or running, so the key stays valid for as
+  // long as p is queued.
+  p->pbs_dp = dynamic_priority(p);
+  heap_push(&rq->pbsq, p, pbs_less);
+#ifdef PREEMPT
+  if(join)
+    pbs_check_preempt(rq);
+#endif
+}
+
+static void
+pbs_dequeue(struct runq *rq, struct proc *p, int leave)
+{
+  heap_remove(&rq->pbsq, p, pbs_less);
+}
+
+static struct proc*
+pbs_pick(struct runq *rq)
+{
+  return heap_min(&rq->pbsq);
+}
+
+// Each run queue keeps its MLFQ processes below level 0 on
+// a timer wheel, hashed by the tick at which they are due
+// for promotion, so aging only looks at the processes that
+// are due. Caller must hold rq->lock.
+static void
+age_insert(struct runq *rq, struct proc *p)
+{
+  struct proc **slot;
+
+  p->age_deadline = ticks + mlfq_aging + 1;
+  slot = &rq->agewheel[p->age_deadline % AGEWHEEL];
+  p->age_prev = 0;
+  p->age_next = *slot;
+  if(*slot)
+    (*slot)->age_prev = p;
+  *slot = p;
+  rq->naging++;
+}
+
+static void
+age_remove(struct runq *rq, struct proc *p)
+{
+  if(p->age_prev)
+    p->age_prev->age_next = p->age_next;
+  else
+    rq->agewheel[p->age_deadline % AGEWHEEL] = p->age_next;
+  if(p->age_next)
+    p->age_next->age_prev = p->age_prev;
+  p->age_next = 0;
+  p->age_prev = 0;
+  rq->naging--;
+}
+
+// MLFQ: one list per level and a bitmap of the non-empty
+// ones, so the highest-priority process is found with a
+// single count-trailing-zeros. A process that is preempted
+// or demoted goes to the tail of its level.
+
+static void
+mlfq_enqueue(struct runq *rq, struct proc *p, int join)
+{
+  struct proc *curr;
+
+  // aging counts from when p was queued on its level.
+  p->q_enter_time = ticks;
+  p->cq_rtime = 0;
+  plist_insert(&rq->mlfq[p->curr_q], rq->mlfq[p->curr_q].tail, p);
+  rq->mlfq_ready |= 1 << p->curr_q;
+  if(p->curr_q > 0)
+    age_insert(rq, p);
+
+  // a process woken at a higher level preempts at once,
+  // rather than at the running one's next tick.
+  curr = rq->cpu->proc;
+  if(join && curr && curr->sched == p->sched && p->curr_q < curr->curr_q)
+    resched(rq->cpu);
+}
+
+static void
+mlfq_dequeue(struct runq *rq, struct proc *p, int leave)
+{
+  plist_remove(&rq->mlfq[p->curr_q], p);
+  if(rq->mlfq[p->curr_q].head == 0)
+    rq->mlfq_ready &= ~(1 << p->curr_q);
+  if(p->curr_q > 0)
+    age_remove(rq, p);
+}
+
+static struct proc*
+mlfq_pick(struct runq *rq)
+{
+  if(rq->mlfq_ready == 0)
+    return 0;
+  return rq->mlfq[__builtin_ctz(rq->mlfq_ready)].head;
+}
+
+// Demote p once it has used up its level's quantum. Returns
+// 1 if p should give up the cpu: it was demoted, or a
+// process is queued here at a higher level.
+static int
+mlfq_tick(struct proc *p)
+{
+  struct runq *rq = &mycpu()->rq;
+  int r = 0;
+
+  acquire(&p->lock);
+  // charge the time run so far to the current level.
+  charge(p);
+  if(p->cq_rtime >= (uint64)mlfq_quantum[p->curr_q] * tick_cycles){
+    if(p->curr_q < MLFQ_LEVELS - 1){
+      rq->demote[p->curr_q]++;
+      p->curr_q++;
+      if(trace_on)
+        trace_event(SEV_LEVEL, cpuid(), p->pid, p->sched->id, p->curr_q);
     }
-    min_proc->state = RUNNING;
-    c->proc = min_proc;
-    swtch(&c->context, &min_proc->context);
-    c->proc = 0;
-    release(&min_proc->lock);
+    p->cq_rtime = 0;
+    r = 1;
+  } else if(rq->mlfq_ready & ((1 << p->curr_q) - 1)){
+    r = 1;
   }
+  release(&p->lock);
+  return r;
 }
 
-void round_robin_scheduler(struct cpu *c)
+static uint64
+mlfq_slice_end(struct proc *p)
 {
-  struct proc *p;
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == RUNNABLE) {
-      // Switch to chosen process.  It is the process's job
-      // to release its lock and then reacquire it
-      // before jumping back to us.
-      p->state = RUNNING;
-      c->proc = p;
-      swtch(&c->context, &p->context);
-
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
+  uint64 q = (uint64)mlfq_quantum[p->curr_q] * tick_cycles;
+
+  if(p->cq_rtime >= q)
+    return 0;
+  return p->state_time + q - p->cq_rtime;
+}
+
+// Advance this cpu's aging wheel to the current tick and
+// move the processes whose deadline has passed up one
+// level. Called on every timer interrupt.
+void
+mlfq_age(void)
+{
+  struct runq *rq = &mycpu()->rq;
+  struct proc *p, *next;
+  uint now = ticks;
+  int q;
+
+  if(rq->naging == 0){
+    rq->age_clock = now;
+    return;
+  }
+  acquire(&rq->lock);
+  // every slot is visited at least once per AGEWHEEL ticks.
+  if(now - rq->age_clock > AGEWHEEL)
+    rq->age_clock = now - AGEWHEEL;
+  while(rq->age_clock != now){
+    rq->age_clock++;
+    for(p = rq->agewheel[rq->age_clock % AGEWHEEL]; p; p = next){
+      next = p->age_next;
+      if(p->age_deadline > now)
+        continue;
+      q = p->curr_q;
+      mlfq_dequeue(rq, p, 0);
+      p->curr_q--;
+      rq->promote[q]++;
+      if(trace_on)
+        trace_event(SEV_AGE, cpuid(), p->pid, p->sched->id, p->curr_q);
+      mlfq_enqueue(rq, p, 1);
     }
-    release(&p->lock);
   }
+  release(&rq->lock);
+}
+
+// Stride: run the queued process with the lowest pass.
+// Passes advance by STRIDE1/tickets per quantum, so over any
+// window each process gets its ticket share to within one
+// quantum.
+
+static int
+stride_less(struct proc *a, struct proc *b)
+{
+  return a->pass < b->pass;
 }
-//implent rand
-int rand(void)
+
+// p stops competing on rq: remember how far its pass is
+// ahead of the queue's virtual time, so that it neither
+// gains nor loses share by sleeping or moving.
+static void
+stride_leave(struct runq *rq, struct proc *p)
 {
-  static unsigned long int next = 1;
-  next = next * 1103515245 + ticks;
-  return((unsigned)(next/65536) % 32768);
+  p->pass_remain = p->pass > rq->vpass ? p->pass - rq->vpass : 0;
 }
 
-void lottery_scheduler(struct cpu *c)
+// p starts competing on rq again.
+static void
+stride_join(struct runq *rq, struct proc *p)
+{
+  p->pass = rq->vpass + p->pass_remain;
+}
+
+static void
+stride_enqueue(struct runq *rq, struct proc *p, int join)
+{
+  if(join)
+    stride_join(rq, p);
+  heap_push(&rq->strideq, p, stride_less);
+}
+
+static void
+stride_dequeue(struct runq *rq, struct proc *p, int leave)
+{
+  heap_remove(&rq->strideq, p, stride_less);
+  if(leave)
+    stride_leave(rq, p);
+}
+
+static struct proc*
+stride_pick(struct runq *rq)
 {
   struct proc *p;
-  int total_tickets = 0;
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == RUNNABLE) {
-      total_tickets += p->tickets;
-    }
 
-    // release(&p->lock);
+  if((p = heap_min(&rq->strideq)) == 0)
+    return 0;
+  if(p->pass > rq->vpass)
+    rq->vpass = p->pass;
+  return p;
+}
+
+// Charge the quantum just used; a sleeper also stops
+// competing on this cpu.
+static void
+stride_yield(struct runq *rq, struct proc *p, int sleeping)
+{
+  p->pass += p->stride;
+  if(sleeping)
+    stride_leave(rq, p);
+}
+
+// CFS: run the queued process with the lowest vruntime, its
+// run time scaled down by its weight, so that over time every
+// process gets cpu in proportion to its weight. The queued
+// processes are kept in a red-black tree, linked through
+// p->rb_*, with the leftmost node cached in rq->cfs_min.
+// Caller must hold rq->lock.
+
+static int
+cfs_less(struct proc *a, struct proc *b)
+{
+  if(a->vruntime != b->vruntime)
+    return a->vruntime < b->vruntime;
+  return a < b;
+}
+
+static int
+rb_isred(struct proc *n)
+{
+  return n != 0 && n->rb_red;
+}
+
+// Put v in u's place under u's parent.
+static void
+rb_replace(struct runq *rq, struct proc *u, struct proc *v)
+{
+  struct proc *pa = u->rb_parent;
+
+  if(pa == 0)
+    rq->cfs_root = v;
+  else
+    pa->rb_child[pa->rb_child[1] == u] = v;
+  if(v)
+    v->rb_parent = pa;
+}
+
+// Rotate the subtree at x left (dir 0) or right (dir 1).
+static void
+rb_rotate(struct runq *rq, struct proc *x, int dir)
+{
+  struct proc *y = x->rb_child[!dir];
+
+  x->rb_child[!dir] = y->rb_child[dir];
+  if(y->rb_child[dir])
+    y->rb_child[dir]->rb_parent = x;
+  rb_replace(rq, x, y);
+  y->rb_child[dir] = x;
+  x->rb_parent = y;
+}
+
+static void
+rb_insert(struct runq *rq, struct proc *p)
+{
+  struct proc *pa = 0, *g, *u, **link = &rq->cfs_root;
+  int dir, leftmost = 1;
+
+  while(*link){
+    pa = *link;
+    dir = !cfs_less(p, pa);
+    if(dir)
+      leftmost = 0;
+    link = &pa->rb_child[dir];
   }
-  if(total_tickets == 0) {
-    for(p = proc; p < &proc[NPROC]; p++) {
-      release(&p->lock);
+  p->rb_parent = pa;
+  p->rb_child[0] = p->rb_child[1] = 0;
+  p->rb_red = 1;
+  *link = p;
+  if(leftmost)
+    rq->cfs_min = p;
+
+  while((pa = p->rb_parent) != 0 && pa->rb_red){
+    g = pa->rb_parent;
+    dir = g->rb_child[1] == pa;
+    u = g->rb_child[!dir];
+    if(rb_isred(u)){
+      pa->rb_red = u->rb_red = 0;
+      g->rb_red = 1;
+      p = g;
+      continue;
     }
-    return;
+    if(p == pa->rb_child[!dir]){
+      // inner grandchild: rotate it to the outside first.
+      rb_rotate(rq, pa, dir);
+      p = pa;
+      pa = p->rb_parent;
+    }
+    pa->rb_red = 0;
+    g->rb_red = 1;
+    rb_rotate(rq, g, !dir);
   }
-  int tochoose = rand() % total_tickets;
-  int curr = 0;
-  int flag = 0;
-  struct proc* win = 0;
-  for(p = proc; p < &proc[NPROC]; p++) {
-    // acquire(&p->lock);
-    if(p->state == RUNNABLE) {
-      curr += p->tickets;
-      if(curr >= tochoose && flag == 0) {
-        // p->state = RUNNING;
-        // c->proc = p;
-        // swtch(&c->context, &p->context);
-        // c->proc = 0;
-        // release(&p->lock);
-        // return;
-        win = p;
-        flag = 1;
-        continue;
+  rq->cfs_root->rb_red = 0;
+}
 
+// Restore the tree after a black node was unlinked from
+// above x (possibly 0), whose parent is now xp.
+static void
+rb_remove_fixup(struct runq *rq, struct proc *x, struct proc *xp)
+{
+  struct proc *w;
+  int dir;
+
+  while(x != rq->cfs_root && !rb_isred(x)){
+    dir = xp->rb_child[1] == x;
+    w = xp->rb_child[!dir];
+    if(w->rb_red){
+      w->rb_red = 0;
+      xp->rb_red = 1;
+      rb_rotate(rq, xp, dir);
+      w = xp->rb_child[!dir];
+    }
+    if(!rb_isred(w->rb_child[0]) && !rb_isred(w->rb_child[1])){
+      w->rb_red = 1;
+      x = xp;
+      xp = x->rb_parent;
+    } else {
+      if(!rb_isred(w->rb_child[!dir])){
+        w->rb_child[dir]->rb_red = 0;
+        w->rb_red = 1;
+        rb_rotate(rq, w, !dir);
+        w = xp->rb_child[!dir];
       }
+      w->rb_red = xp->rb_red;
+      xp->rb_red = 0;
+      w->rb_child[!dir]->rb_red = 0;
+      rb_rotate(rq, xp, dir);
+      x = rq->cfs_root;
     }
-    release(&p->lock);
   }
+  if(x)
+    x->rb_red = 0;
+}
 
-  if(win != 0 ) {
-    // acquire(&win->lock);
-    if(win->state != RUNNABLE) {
-      release(&win->lock);
-      return;
+static void
+rb_remove(struct runq *rq, struct proc *z)
+{
+  struct proc *x, *xp, *y;
+  int red = z->rb_red;
+
+  if(rq->cfs_min == z){
+    // the leftmost node has no left child.
+    if((y = z->rb_child[1]) != 0)
+      while(y->rb_child[0])
+        y = y->rb_child[0];
+    else
+      y = z->rb_parent;
+    rq->cfs_min = y;
+  }
+
+  if(z->rb_child[0] == 0 || z->rb_child[1] == 0){
+    x = z->rb_child[z->rb_child[0] == 0];
+    xp = z->rb_parent;
+    rb_replace(rq, z, x);
+  } else {
+    // replace z by its successor y.
+    y = z->rb_child[1];
+    while(y->rb_child[0])
+      y = y->rb_child[0];
+    red = y->rb_red;
+    x = y->rb_child[1];
+    if(y->rb_parent == z){
+      xp = y;
+    } else {
+      xp = y->rb_parent;
+      rb_replace(rq, y, x);
+      y->rb_child[1] = z->rb_child[1];
+      y->rb_child[1]->rb_parent = y;
     }
-    win->state = RUNNING;
-    c->proc = win;
-    swtch(&c->context, &win->context);
-    c->proc = 0;
-    release(&win->lock);
+    rb_replace(rq, z, y);
+    y->rb_child[0] = z->rb_child[0];
+    y->rb_child[0]->rb_parent = y;
+    y->rb_red = z->rb_red;
   }
+  if(!red)
+    rb_remove_fixup(rq, x, xp);
+  z->rb_child[0] = z->rb_child[1] = z->rb_parent = 0;
 }
 
-int dynamic_priority(struct proc *p)
+// Weights by nice value, -20 to 19. Each step is worth about
+// 10% of the cpu; nice 0 is 1024.
+static const int cfs_weights[40] = {
+  88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+  9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+  1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+  110, 87, 70, 56, 45, 36, 29, 23, 18, 15,
+};
+
+// setpriority()'s 0 to 100, default 60, maps to nice
+// (priority - 60) / 2.
+static int
+cfs_weight(struct proc *p)
 {
-  int niceness;
-  if(((p->sleep_ticks + p->run_ticks) == 0)){
-    niceness = 5;
+  int nice = (p->static_priority - 60) / 2;
+
+  if(nice < -20)
+    nice = -20;
+  if(nice > 19)
+    nice = 19;
+  return cfs_weights[nice + 20];
+}
+
+// Move min_vruntime up to the lowest vruntime of curr, the
+// running process if it is CFS, and the queued ones.
+static void
+cfs_update_min(struct runq *rq, struct proc *curr)
+{
+  uint64 v;
+
+  if(curr)
+    v = curr->vruntime;
+  else if(rq->cfs_min)
+    v = rq->cfs_min->vruntime;
+  else
+    return;
+  if(rq->cfs_min && rq->cfs_min->vruntime < v)
+    v = rq->cfs_min->vruntime;
+  if(v > rq->min_vruntime)
+    rq->min_vruntime = v;
+}
+
+// Charge p, running on rq's cpu, for the time since it was
+// last charged.
+static void
+cfs_update_curr(struct runq *rq, struct proc *p)
+{
+  uint64 now = r_time();
+
+  p->vruntime += (now - p->exec_start) * 1024 / cfs_weight(p);
+  p->exec_start = now;
+  cfs_update_min(rq, p);
+}
+
+// p starts competing on rq: turn its lag back into a
+// vruntime there. A sleeper is credited with the time it
+// slept, but ends up at most CFS_SLEEPER_CREDIT behind
+// min_vruntime, so that it runs soon after waking without
+// being able to bank cpu time by sleeping.
+static void
+cfs_join(struct runq *rq, struct proc *p)
+{
+  long lag = p->vlag;
+
+  if(p->cfs_slept){
+    lag -= (long)(r_time() - p->cfs_slept);
+    if(lag < -CFS_SLEEPER_CREDIT)
+      lag = -CFS_SLEEPER_CREDIT;
+    p->cfs_slept = 0;
   }
-  else{
-    niceness = p->sleep_ticks/(p->sleep_ticks + p->run_ticks);
-    niceness = niceness * 10;
+  if(lag < 0 && -lag > rq->min_vruntime)
+    p->vruntime = 0;
+  else
+    p->vruntime = rq->min_vruntime + lag;
+}
+
+static void
+cfs_enqueue(struct runq *rq, struct proc *p, int join)
+{
+  struct proc *curr;
+
+  if(join)
+    cfs_join(rq, p);
+  p->cfs_weight = cfs_weight(p);
+  rq->cfs_load += p->cfs_weight;
+  rb_insert(rq, p);
+
+  // a woken process well behind the running one preempts it.
+  curr = rq->cpu->proc;
+  if(join && curr && curr->sched == p->sched &&
+     p->vruntime + CFS_WAKEUP_GRAN < curr->vruntime)
+    resched(rq->cpu);
+}
+
+static void
+cfs_dequeue(struct runq *rq, struct proc *p, int leave)
+{
+  rb_remove(rq, p);
+  rq->cfs_load -= p->cfs_weight;
+  if(leave)
+    p->vlag = (long)(p->vruntime - rq->min_vruntime);
+}
+
+static struct proc*
+cfs_pick(struct runq *rq)
+{
+  struct proc *p;
+
+  if((p = rq->cfs_min) == 0)
+    return 0;
+  p->exec_start = p->slice_start = r_time();
+  cfs_update_min(rq, p);
+  return p;
+}
+
+// p's share of CFS_LATENCY by weight, against the
+// processes queued on rq.
+static uint64
+cfs_slice(struct runq *rq, struct proc *p)
+{
+  uint64 w = cfs_weight(p);
+  uint64 slice = CFS_LATENCY * w / (rq->cfs_load + w);
+
+  if(slice < CFS_MINGRAN)
+    slice = CFS_MINGRAN;
+  return slice;
+}
+
+// Preempt p once it has run for its slice, if a queued
+// process is behind it.
+static int
+cfs_tick(struct proc *p)
+{
+  struct runq *rq = &mycpu()->rq;
+  int r = 0;
+
+  acquire(&rq->lock);
+  cfs_update_curr(rq, p);
+  if(rq->cfs_min && rq->cfs_min->vruntime < p->vruntime)
+    r = r_time() - p->slice_start >= cfs_slice(rq, p);
+  release(&rq->lock);
+  return r;
+}
+
+// Nothing to time unless a process is waiting here.
+static uint64
+cfs_slice_end(struct proc *p)
+{
+  struct runq *rq = &mycpu()->rq;
+  uint64 end = 0;
+
+  acquire(&rq->lock);
+  if(rq->cfs_min)
+    end = p->slice_start + cfs_slice(rq, p);
+  release(&rq->lock);
+  return end;
+}
+
+// Charge the run that is ending; a sleeper also stops
+// competing on this cpu and remembers when it slept.
+static void
+cfs_yield(struct runq *rq, struct proc *p, int sleeping)
+{
+  acquire(&rq->lock);
+  cfs_update_curr(rq, p);
+  if(sleeping){
+    p->vlag = (long)(p->vruntime - rq->min_vruntime);
+    p->cfs_slept = r_time();
   }
+  release(&rq->lock);
+}
 
-  int DP = p->static_priority - niceness + 5;
-  if(DP > 100){
-    DP = 100;
+// EDF: run the queued process whose current job has the
+// earliest absolute deadline. A process declares a runtime,
+// deadline and period with setdeadline(); every period it
+// releases a job that may run for runtime and is due
+// deadline after its release. A process is admitted to a cpu
+// only while that cpu's EDF bandwidth, the sum of runtime /
+// period, stays within EDF_MAXBW, so every deadline can be
+// met there; it then stays on that cpu. The clock interrupt
+// charges the running job, and a job that has used up its
+// runtime is throttled until its next release.
+// Caller must hold rq->lock.
+
+static int
+edf_less(struct proc *a, struct proc *b)
+{
+  return a->dl_abs < b->dl_abs;
+}
+
+// Count a miss if p's current job still wants the cpu
+// after its deadline.
+static void
+edf_check_miss(struct proc *p, uint64 now)
+{
+  if(!p->dl_missed && now > p->dl_abs){
+    p->dl_missed = 1;
+    p->dl_nmiss++;
   }
-  if(DP < 0){
-    DP = 0;
+}
+
+// If p's next release has come, start the job released
+// last, with a full budget.
+static void
+edf_release(struct proc *p, uint64 now)
+{
+  if(now < p->dl_release + p->dl_period)
+    return;
+  p->dl_release += (now - p->dl_release) / p->dl_period * p->dl_period;
+  p->dl_abs = p->dl_release + p->dl_deadline;
+  p->dl_budget = p->dl_runtime;
+  p->dl_throttled = 0;
+  p->dl_missed = 0;
+  p->dl_njobs++;
+}
+
+// Charge the running p's job for the time since it was
+// last charged.
+static void
+edf_charge(struct proc *p)
+{
+  uint64 now = r_time();
+
+  p->dl_budget -= (long)(now - p->dl_exec);
+  p->dl_exec = now;
+}
+
+// Should p preempt curr, the process running on its cpu?
+// EDF takes precedence over every other class.
+static int
+edf_preempts(struct proc *p, struct proc *curr)
+{
+  return curr && (curr->sched != p->sched || p->dl_abs < curr->dl_abs);
+}
+
+static void
+edf_enqueue(struct runq *rq, struct proc *p, int join)
+{
+  if(join)
+    edf_release(p, r_time());
+  if(p->dl_budget <= 0){
+    // wait for the next release on dl_throttled.
+    if(!p->dl_throttled)
+      p->dl_nthrottle++;
+    p->dl_throttled = 1;
+    plist_insert(&rq->dl_throttled, rq->dl_throttled.tail, p);
+    rq->ndl_throttled++;
+    return;
   }
-  return DP;
+  heap_push(&rq->edfq, p, edf_less);
+  if(edf_preempts(p, rq->cpu->proc))
+    resched(rq->cpu);
 }
 
-void
-priority_scheduler(struct cpu *c)
+static void
+edf_dequeue(struct runq *rq, struct proc *p, int leave)
+{
+  if(p->dl_throttled){
+    plist_remove(&rq->dl_throttled, p);
+    rq->ndl_throttled--;
+  } else {
+    heap_remove(&rq->edfq, p, edf_less);
+  }
+}
+
+static struct proc*
+edf_pick(struct runq *rq)
 {
   struct proc *p;
-  struct proc *high_proc = 0;
-  // int high_priority = 101;
-  for (p = proc; p < &proc[NPROC]; p++){
-    // int flag = 0;
-    acquire(&p->lock);
-    if(p->state == RUNNABLE){
 
-      // comparing .............
-      if(high_proc == 0){
-        high_proc = p;
-        // flag = 1;
-      }
-      else{
-        int high_priority = dynamic_priority(high_proc);
-        int curr_priority = dynamic_priority(p);
-        if(curr_priority < high_priority){
-          release(&high_proc->lock);
-          high_proc = p;
-          // flag = 1;
-        }
-        else if (curr_priority == high_priority) {
-          if(p->num_scheduled < high_proc->num_scheduled){
-            release(&high_proc->lock);
-            high_proc = p;
-            // flag = 1;
-          }
-          else if(p->num_scheduled == high_proc->num_scheduled){
-
-            if(p->start_ticks < high_proc->start_ticks){
-              release(&high_proc->lock);
-              high_proc = p;
-              // flag = 1;
-            }
-          }
-        }
-      }
+  if((p = heap_min(&rq->edfq)) == 0)
+    return 0;
+  p->dl_exec = r_time();
+  edf_check_miss(p, p->dl_exec);
+  return p;
+}
 
+// Preempt p once its job has used up its budget.
+static int
+edf_tick(struct proc *p)
+{
+  int r;
 
+  acquire(&p->lock);
+  edf_charge(p);
+  edf_check_miss(p, p->dl_exec);
+  r = p->dl_budget <= 0;
+  release(&p->lock);
+  return r;
+}
 
+static uint64
+edf_slice_end(struct proc *p)
+{
+  if(p->dl_budget <= 0)
+    return 0;
+  return p->dl_exec + p->dl_budget;
+}
+
+static void
+edf_yield(struct runq *rq, struct proc *p, int sleeping)
+{
+  edf_charge(p);
+  edf_check_miss(p, p->dl_exec);
+}
+
+// Start the next job of each throttled process on this cpu
+// whose release has come. Called on every timer interrupt.
+void
+edf_replenish(void)
+{
+  struct runq *rq = &mycpu()->rq;
+  struct proc *p, *next;
+  uint64 now;
+
+  if(rq->ndl_throttled == 0)
+    return;
+  acquire(&rq->lock);
+  now = r_time();
+  for(p = rq->dl_throttled.head; p; p = next){
+    next = p->cl_next;
+    if(now < p->dl_release + p->dl_period)
+      continue;
+    plist_remove(&rq->dl_throttled, p);
+    rq->ndl_throttled--;
+    // it wanted the cpu all the while it was throttled.
+    edf_check_miss(p, now);
+    edf_release(p, now);
+    heap_push(&rq->edfq, p, edf_less);
+    if(edf_preempts(p, rq->cpu->proc))
+      resched(rq->cpu);
+  }
+  release(&rq->lock);
+}
+
+// Give back p's EDF bandwidth.
+// Caller must hold p->lock.
+static void
+edf_leave(struct proc *p)
+{
+  acquire(&dl_lock);
+  cpus[p->dl_cpu].rq.dl_bw -= p->dl_bw;
+  release(&dl_lock);
+  p->dl_bw = 0;
+}
+
+#ifndef SCHED_DEFAULT
+#define SCHED_DEFAULT SCHED_RR
+#endif
+#if SCHED_DEFAULT == SCHED_EDF
+#error "EDF needs parameters, see setdeadline()"
+#endif
+
+// The scheduling classes, highest precedence first.
+struct sched_class sched_classes[NSCHED] = {
+  // id         name      enqueue         dequeue         pick_next    tick         yield_hook    slice_end
+  { SCHED_EDF,    "edf",    edf_enqueue,    edf_dequeue,    edf_pick,    edf_tick,    edf_yield,    edf_slice_end },
+  { SCHED_RR,     "rr",     rr_enqueue,     rr_dequeue,     rr_pick,     tick_always, 0,            0 },
+  { SCHED_FCFS,   "fcfs",   fcfs_enqueue,   fcfs_dequeue,   fcfs_pick,   tick_slice,  0,            0 },
+  { SCHED_LBS,    "lbs",    lbs_enqueue,    lbs_dequeue,    lbs_pick,    tick_always, 0,            0 },
+  { SCHED_PBS,    "pbs",    pbs_enqueue,    pbs_dequeue,    pbs_pick,    tick_slice,  0,            0 },
+  { SCHED_MLFQ,   "mlfq",   mlfq_enqueue,   mlfq_dequeue,   mlfq_pick,   mlfq_tick,   0,            mlfq_slice_end },
+  { SCHED_STRIDE, "stride", stride_enqueue, stride_dequeue, stride_pick, tick_always, stride_yield, 0 },
+  { SCHED_CFS,    "cfs",    cfs_enqueue,    cfs_dequeue,    cfs_pick,    cfs_tick,    cfs_yield,    cfs_slice_end },
+};
+
+// The class with the given SCHED_* id, or 0.
+static struct sched_class*
+sched_lookup(int id)
+{
+  for(struct sched_class *cl = sched_classes; cl < &sched_classes[NSCHED]; cl++)
+    if(cl->id == id)
+      return cl;
+  return 0;
+}
+
+// Link p into rq. join is set when p was not just running
+// on rq's cpu: it is new, woke up, or moved from another cpu.
+// Caller must hold rq->lock.
+static void
+runq_insert(struct runq *rq, struct proc *p, int join)
+{
+  struct proc *curr;
+
+  p->rq = rq;
+  p->rq_next = 0;
+  p->rq_prev = rq->all.tail;
+  if(rq->all.tail)
+    rq->all.tail->rq_next = p;
+  else
+    rq->all.head = p;
+  rq->all.tail = p;
+  rq->size++;
+  p->sched->enqueue(rq, p, join);
+  if(trace_on)
+    trace_event(SEV_ENQUEUE, rq->cpu - cpus, p->pid, p->sched->id, p->curr_q);
+
+  // a class that takes precedence preempts at once.
+  curr = rq->cpu->proc;
+  if(join && curr && p->sched < curr->sched)
+    resched(rq->cpu);
+
+  // wake the cpu if it is idle; see cpu_idle().
+  __sync_synchronize();
+  if(rq->cpu->idle && rq->cpu != mycpu())
+    ipi(rq->cpu - cpus);
+}
+
+// Unlink p from rq. leave is set when p moves to another
+// cpu rather than running on this one.
+// Caller must hold rq->lock.
+static void
+runq_remove(struct runq *rq, struct proc *p, int leave)
+{
+  if(p->rq != rq)
+    panic("runq_remove");
+  p->sched->dequeue(rq, p, leave);
+  if(trace_on)
+    trace_event(SEV_DEQUEUE, rq->cpu - cpus, p->pid, p->sched->id, p->curr_q);
+  if(p->rq_prev)
+    p->rq_prev->rq_next = p->rq_next;
+  else
+    rq->all.head = p->rq_next;
+  if(p->rq_next)
+    p->rq_next->rq_prev = p->rq_prev;
+  else
+    rq->all.tail = p->rq_prev;
+  p->rq = 0;
+  p->rq_next = 0;
+  p->rq_prev = 0;
+  rq->size--;
+}
+
+// Add a RUNNABLE process to rq.
+static void
+runq_add(struct runq *rq, struct proc *p, int join)
+{
+  acquire(&rq->lock);
+  if(p->rq)
+    panic("runq_add");
+  runq_insert(rq, p, join);
+  release(&rq->lock);
+}
+
+// Take the process to run next off rq: the pick of the
+// first class that has one.
+static struct proc*
+runq_pick(struct runq *rq)
+{
+  struct sched_class *cl;
+  struct proc *p = 0;
+
+  acquire(&rq->lock);
+  for(cl = sched_classes; rq->size > 0 && cl < &sched_classes[NSCHED]; cl++)
+    if((p = cl->pick_next(rq)) != 0){
+      runq_remove(rq, p, 0);
+      break;
     }
-    if(p != high_proc){
-      release(&p->lock);
-    }
+  release(&rq->lock);
+  return p;
+}
+
+// Number of processes a cpu is running or has queued.
+// Read without locks, it is only a placement hint.
+static int
+runq_load(struct cpu *c)
+{
+  return c->rq.size + (c->proc != 0);
+}
+
+// The cpu p has to run on, or 0 if it may run on any.
+static struct cpu*
+runq_bound(struct proc *p)
+{
+  if(p->sched->id == SCHED_EDF)
+    return &cpus[p->dl_cpu];
+  return 0;
+}
+
+// May p run on c?
+static int
+runq_allowed(struct proc *p, struct cpu *c)
+{
+  return (p->cpumask >> (c - cpus)) & 1;
+}
+
+// Choose a run queue for p, which has just become RUNNABLE:
+// the least loaded of the cpus that are scheduling and that
+// p may run on. p stays on the cpu it last ran on, where its
+// cache is warm, unless that has AFFINITYSLACK more load.
+static struct cpu*
+runq_select(struct proc *p)
+{
+  struct cpu *c, *best = 0, *last = 0;
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->started || !runq_allowed(p, c))
+      continue;
+    if(c - cpus == p->last_cpu)
+      last = c;
+    if(best == 0 || runq_load(c) < runq_load(best))
+      best = c;
+  }
+  if(last && runq_load(last) <= runq_load(best) + AFFINITYSLACK)
+    return last;
+  if(best == 0)
+    best = mycpu();
+  return best;
+}
+
+// Take a process off victim's run queue so that c can run
+// it. Processes that ran within the last MIGRATECOST ticks
+// still have a warm cache on victim and are skipped; if all
+// of them are warm and force is set, the one queued last is
+// taken anyway. Processes that may not run on c never move.
+static struct proc*
+runq_detach(struct cpu *victim, struct cpu *c, int force)
+{
+  struct runq *rq = &victim->rq;
+  struct proc *p;
+
+  acquire(&rq->lock);
+  for(p = rq->all.tail; p; p = p->rq_prev)
+    if(runq_bound(p) == 0 && runq_allowed(p, c) && ticks - p->last_run > MIGRATECOST)
+      break;
+  if(p == 0 && force)
+    for(p = rq->all.tail; p && (runq_bound(p) || !runq_allowed(p, c)); p = p->rq_prev)
+      ;
+  if(p)
+    runq_remove(rq, p, 1);
+  release(&rq->lock);
+  return p;
+}
+
+// Queue p, taken off another cpu's run queue, on c.
+static void
+migrate(struct proc *p, struct cpu *c)
+{
+  acquire(&p->lock);
+  runq_add(&c->rq, p, 1);
+  release(&p->lock);
+  __sync_fetch_and_add(&p->migrations, 1);
+  __sync_fetch_and_add(&c->nmigrate, 1);
+}
+
+// Called by an idle cpu: steal a process from the cpu
+// with the longest run queue.
+static void
+runq_steal(struct cpu *c)
+{
+  struct cpu *v, *busiest = 0;
+  struct proc *p;
 
+  for(v = cpus; v < &cpus[NCPU]; v++){
+    if(v == c || !v->started || v->rq.size == 0)
+      continue;
+    if(busiest == 0 || v->rq.size > busiest->rq.size)
+      busiest = v;
   }
+  if(busiest == 0 || (p = runq_detach(busiest, c, 1)) == 0)
+    return;
+  c->nsteal++;
+  migrate(p, c);
+}
 
-  // scedueling
-  if(high_proc != 0){
-    // acquire(&high_proc->lock);
-    if(high_proc->state == RUNNABLE){
-      high_proc->state = RUNNING;
-
-      high_proc->num_scheduled++;
-      high_proc->run_ticks = 0;
-      high_proc->sleep_ticks = 0;
+// Move work from the busiest to the least loaded cpu
+// until their loads are within one of each other, without
+// moving cache-warm processes. Called from clockintr()
+// every BALANCETICKS ticks.
+void
+rebalance(void)
+{
+  struct cpu *c, *busiest, *idlest;
+  struct proc *p;
 
-      c->proc = high_proc;
-      swtch(&c->context, &high_proc->context);
-      c->proc = 0;
+  for(int moves = 0; moves < NCPU; moves++){
+    busiest = idlest = 0;
+    for(c = cpus; c < &cpus[NCPU]; c++){
+      if(!c->started)
+        continue;
+      if(busiest == 0 || runq_load(c) > runq_load(busiest))
+        busiest = c;
+      if(idlest == 0 || runq_load(c) < runq_load(idlest))
+        idlest = c;
     }
-    release(&high_proc->lock);
+    if(busiest == 0 || runq_load(busiest) - runq_load(idlest) < 2)
+      break;
+    if((p = runq_detach(busiest, idlest, 0)) == 0)
+      break;
+    migrate(p, idlest);
   }
-
-
 }
 
-void queue_switch()
+// Ask c to give up the process it is running for a better
+// one queued there. Another cpu is sent an IPI, so that it
+// switches now rather than at its next tick.
+// Interrupts must be disabled.
+static void
+resched(struct cpu *c)
 {
+  c->need_resched = 1;
+  if(c != mycpu())
+    ipi(c - cpus);
+}
 
+// Should the process running on this cpu give it up
+// for a better one that was queued here?
+int
+resched_pending(void)
+{
+  int r;
 
-  for(int q=1; q<MLFQ_LEVELS; q++){
+  push_off();
+  r = mycpu()->need_resched;
+  pop_off();
+  return r;
+}
 
-    while(!que_empty(&mlfqs[q])){
-      struct proc *p = que_front(&mlfqs[q]);
-      acquire(&p->lock);
-      if(p->state == RUNNABLE && (ticks - p->q_enter_time) > 30){
-        que_pop(&mlfqs[q]);
-        p->curr_q--;
-        // p->q_enter_time = ticks;
-        p->cq_rticks = 0;
-        que_push(&mlfqs[q-1], p);
-        release(&p->lock);
-      }
-      else{
-        release(&p->lock);
-        break;
-      }
+// Time the end of p's slice on c, the cpu it is about to
+// run or running on. Interrupts must be disabled.
+static void
+sched_slice(struct cpu *c, struct proc *p)
+{
+  c->slice_end = p->sched->slice_end ? p->sched->slice_end(p) : 0;
+  clockprogram();
+}
 
-    }
+// Called on a clock tick, or when its slice ran out, for p,
+// the process running on this cpu. Returns 1 if p's class
+// wants it preempted.
+int
+sched_tick(struct proc *p)
+{
+  if(!p->sched->tick(p)){
+    sched_slice(mycpu(), p);
+    return 0;
   }
+  __sync_fetch_and_add(&p->sched->npreempt, 1);
+  return 1;
+}
 
+// Mark p RUNNABLE and queue it for a cpu.
+// Caller must hold p->lock.
+void
+setrunnable(struct proc *p)
+{
+  if(!holding(&p->lock))
+    panic("setrunnable");
+  struct cpu *c;
+
+  setstate(p, RUNNABLE);
+  p->wake_time = p->state_time;
+  if((c = runq_bound(p)) == 0)
+    c = runq_select(p);
+  runq_add(&c->rq, p, 1);
 }
 
+// Count a process woken or created lat mtime cycles ago
+// that c is about to run.
+static void
+wakelat(struct cpu *c, uint64 lat)
+{
+  c->nwakeup++;
+  c->wakelat += lat;
+  if(lat > c->wakelat_max)
+    c->wakelat_max = lat;
+}
 
-void mlfq_scheduler(struct cpu *c)
+// Switch to p, which the caller has taken off a run queue.
+// Returns once p gives up the cpu again.
+static void
+runproc(struct cpu *c, struct proc *p)
 {
-  // switch queue if any process is suppose to change ques
-  queue_switch();
-  // que all unqueued processes to queue their curr_q
-  struct proc *p;
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == RUNNABLE && p->qued_fl == 0) {
-      p->q_enter_time = ticks;
-      p->cq_rticks = 0;
-      p->qued_fl = 1;
-      que_push(&mlfqs[p->curr_q], p);
+  acquire(&p->lock);
+  if(p->state == RUNNABLE) {
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    setstate(p, RUNNING);
+    if(p->wake_time){
+      wakelat(c, p->state_time - p->wake_time);
+      p->wake_time = 0;
     }
-    release(&p->lock);
-  }
-  struct proc *torun = 0;
-  for (int q = 0; q < MLFQ_LEVELS; q++) {
-    while(!que_empty(&mlfqs[q])) {
-      struct proc *p = que_pop(&mlfqs[q]);
-      acquire(&p->lock);
-      p->qued_fl = 0;
-      if(p->state == RUNNABLE) {
-        torun = p;
-        break;
-      }
-
-      release(&p->lock);
+    if(p->rejoin){
+      p->rejoin = 0;
+      sched_rejoin(c, p);
     }
-    if(torun != 0) {
-      break;
+    p->num_scheduled++;
+    p->run_time = 0;
+    p->sleep_time = 0;
+    p->slice_ticks = 0;
+    // p's kernel stack may have been mapped since this
+    // hart last flushed its TLB.
+    if(c->kstack_gen != kstack_gen){
+      c->kstack_gen = kstack_gen;
+      sfence_vma();
     }
-  }
-  if(torun != 0) {
-    torun->state = RUNNING;
-    c->proc = torun;
-    swtch(&c->context, &torun->context);
+    c->proc = p;
+    p->last_cpu = c - cpus;
+    if(trace_on)
+      trace_event(SEV_SWITCH, c - cpus, p->pid, p->sched->id, p->curr_q);
+    c->nswitch++;
+    c->need_resched = 0;
+    __sync_fetch_and_add(&p->sched->nswitch, 1);
+    sched_slice(c, p);
+    swtch(&c->context, &p->context);
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
     c->proc = 0;
-    torun->q_enter_time = ticks;
-    torun->cq_rticks = 0;
-    torun->qued_fl = 1;
-    // if(torun->cq_rticks >= (1 << torun->curr_q)) {
-    //   if(torun->curr_q < MLFQ_LEVELS - 1) {
-    //     torun->curr_q++;
-    //   }
-    //   torun->cq_rticks = 0;
-    //   torun->qued_fl = 1;
-    //   que_push(&mlfqs[torun->curr_q], torun);
-    // }
-    // else {
-    //   torun->qued_fl = 1;
-    //   que_pushfront(&mlfqs[torun->curr_q], torun);
-    // }
-    que_push(&mlfqs[torun->curr_q], torun);
+    c->slice_end = 0;
+    p->last_run = ticks;
+  }
+  release(&p->lock);
+}
 
-    release(&torun->lock);
+// Nothing to run on c: wait for an interrupt in wfi rather
+// than spin. Unless processes are queued here for later, the
+// clock tick stops too. runq_insert() sends an IPI when it
+// queues work here; hart 0 is still woken for the timer
+// wheel.
+static void
+cpu_idle(struct cpu *c)
+{
+  uint64 t0;
+
+  intr_off();
+  c->idle = 1;
+  // a process queued before runq_insert() could see
+  // c->idle got no IPI.
+  __sync_synchronize();
+  if(c->rq.size > c->rq.ndl_throttled){
+    c->idle = 0;
+    return;
   }
+  clockidle();
+  t0 = r_time();
+  asm volatile("wfi");
+  c->idle_time += r_time() - t0;
+  c->idle = 0;
+  // scheduler()'s intr_on() takes the interrupt.
 }
 
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - choose a process to run.
+//  - swtch to start running that process.
+//  - eventually that process transfers control
+//    via swtch back to the scheduler.
+void
+scheduler(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *p;
 
+  c->proc = 0;
+  c->started = 1;
+  for(;;){
+    // Avoid deadlock by ensuring that devices can interrupt.
+    intr_on();
+    // Nothing that can run queued here: take work from
+    // the busiest cpu instead of spinning.
+    if(c->rq.size == c->rq.ndl_throttled)
+      runq_steal(c);
+    if((p = runq_pick(&c->rq)) != 0)
+      runproc(c, p);
+    else
+      cpu_idle(c);
+  }
+}
 
 // Switch to scheduler.  Must hold only p->lock
 // and have changed proc->state. Saves and restores
@@ -976,8 +2673,20 @@ void
 yield(void)
 {
   struct proc *p = myproc();
+  struct cpu *c;
+
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  setstate(p, RUNNABLE);
+  if(p->sched->yield_hook)
+    p->sched->yield_hook(&mycpu()->rq, p, 0);
+  // back onto this cpu's queue, where the cache is still
+  // warm, unless p has to run elsewhere.
+  if((c = runq_bound(p)) == 0 && !runq_allowed(p, mycpu()))
+    c = runq_select(p);
+  if(c != 0 && c != mycpu())
+    runq_add(&c->rq, p, 1);
+  else
+    runq_add(&mycpu()->rq, p, 0);
   sched();
   release(&p->lock);
 }
@@ -1003,53 +2712,118 @@ forkret(void)
   usertrapret();
 }
 
+// The wait queue that sleepers on chan hash to.
+static struct waitq*
+waitq_of(void *chan)
+{
+  return &waitq[((uint64)chan * 0x9E3779B97F4A7C15ULL >> 32) % NWAITQ];
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = waitq_of(chan);
 
-  // Must acquire p->lock in order to
-  // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Must acquire wq->lock in order to join chan's
+  // wait queue, and p->lock in order to change
+  // p->state and then call sched.
+  // Once we hold wq->lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks wq->lock),
   // so it's okay to release lk.
 
+  acquire(&wq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
   release(lk);
 
-  // Go to sleep.
+  // Go to sleep, last in line on wq.
   p->chan = chan;
-  p->state = SLEEPING;
+  p->wq_next = 0;
+  p->wq_prev = wq->tail;
+  if(wq->tail)
+    wq->tail->wq_next = p;
+  else
+    wq->head = p;
+  wq->tail = p;
+  setstate(p, SLEEPING);
+  if(p->sched->yield_hook)
+    p->sched->yield_hook(&mycpu()->rq, p, 1);
+  release(&wq->lock);
 
   sched();
 
-  // Tidy up.
+  // Tidy up. Once chan is cleared wakeup() ignores p,
+  // so it can leave wq after giving up p->lock.
   p->chan = 0;
+  release(&p->lock);
+
+  acquire(&wq->lock);
+  if(p->wq_prev)
+    p->wq_prev->wq_next = p->wq_next;
+  else
+    wq->head = p->wq_next;
+  if(p->wq_next)
+    p->wq_next->wq_prev = p->wq_prev;
+  else
+    wq->tail = p->wq_prev;
+  p->wq_next = 0;
+  p->wq_prev = 0;
+  release(&wq->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
+// Wake up to n of the processes sleeping on chan, oldest
+// first, or all of them if n < 0, and return how many woke.
+// Only chan's wait queue is searched, not the whole process
+// table.
+static int
+waitq_wake(void *chan, int n)
+{
+  struct waitq *wq = waitq_of(chan);
+  struct proc *p;
+  int woke = 0;
+
+  acquire(&wq->lock);
+  for(p = wq->head; p && woke != n; p = p->wq_next){
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan){
+      setrunnable(p);
+      woke++;
+    }
+    release(&p->lock);
+  }
+  release(&wq->lock);
+  return woke;
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  waitq_wake(chan, -1);
+}
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-    }
-  }
+// Wake up the process that has slept longest on chan.
+// For exclusive waiters, where each wakeup can satisfy
+// only one of them. Must be called without any p->lock.
+void
+wakeup_one(void *chan)
+{
+  waitq_wake(chan, 1);
+}
+
+// Wake up to n processes sleeping on chan, oldest first,
+// and return how many woke.
+int
+wakeup_n(void *chan, int n)
+{
+  return waitq_wake(chan, n);
 }
 
 // Kill the process with the given pid.
@@ -1060,20 +2834,15 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    setrunnable(p);
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 void
@@ -1143,15 +2912,18 @@ procdump(void)
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(int i = 0; i < nprocs; i++){
+    p = procs[i];
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
       state = states[p->state];
     else
       state = "???";
-    printf("%d %s %s %d %d %d %d %d %d %d", p->pid, state, p->name, p->q_ticks[0], p->q_ticks[1], p->q_ticks[2], p->q_ticks[3], p->q_ticks[4], p->tickets, p->static_priority);
-    // printf("%d %d %d %d %d",mlfqs[0]->head,mlfqs[1]->head,mlfqs[2]->head,mlfqs[3]->head,mlfqs[4]->head);
+    printf("%d %s %s", p->pid, state, p->name);
+    for(int q = 0; q < MLFQ_LEVELS; q++)
+      printf(" %d", (int)(p->q_time[q] / tick_cycles));
+    printf(" %d %d", p->tickets, p->static_priority);
     printf("\n");
   }
 }
@@ -1207,193 +2979,454 @@ sigreturn(){
 
 }
 
-void
+// Set the calling process's lottery tickets.
+// Returns -1 if number is not positive.
+int
 settickets(int number)
 {
   struct proc *p = myproc();
+  struct runq *rq;
+
+  if(number < 1)
+    return -1;
+  acquire(&p->lock);
+  p->stride = STRIDE1 / number;
+  if(p->stride == 0)
+    p->stride = 1;
+  if((rq = p->rq) != 0 && p->sched->id == SCHED_LBS){
+    acquire(&rq->lock);
+    tix_add(rq, p->slot, number - p->rq_tickets);
+    p->rq_tickets = number;
+    release(&rq->lock);
+  }
   p->tickets = number;
+  release(&p->lock);
+  return 0;
 }
 
+// Copy cpu id's scheduler statistics to user address addr.
+// The longest wakeup wait starts again from 0, so that each
+// call sees the longest since the one before.
 int
-set_priority(int priority, int pid)
+schedstat(int id, uint64 addr)
+{
+  struct schedstat st;
+  struct cpu *c;
+
+  if(id < 0 || id >= NCPU)
+    return -1;
+  c = &cpus[id];
+  st.started = c->started;
+  st.nrunnable = c->rq.size;
+  st.nswitch = c->nswitch;
+  st.nsteal = c->nsteal;
+  st.nmigrate = c->nmigrate;
+  st.idletime = c->idle_time;
+  st.nwakeup = c->nwakeup;
+  st.wakelat = c->wakelat;
+  st.wakelatmax = __sync_lock_test_and_set(&c->wakelat_max, 0);
+  memset(&st.hist, 0, sizeof(st.hist));
+  memmove(st.hist.count, c->hist, sizeof(c->hist));
+  memmove(st.hist.max, c->hist_max, sizeof(c->hist_max));
+  if(copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// p, about to run or running on c but on no queue, has
+// changed class: start its run now, level with the virtual
+// time of c's queue, as runq_insert() would on joining it.
+// A stride process is charged its quantum when it yields.
+// Caller must hold p->lock.
+static void
+sched_rejoin(struct cpu *c, struct proc *p)
+{
+  acquire(&c->rq.lock);
+  if(p->sched->id == SCHED_CFS){
+    p->vruntime = c->rq.min_vruntime;
+    p->vlag = 0;
+    p->cfs_slept = 0;
+    p->exec_start = p->slice_start = r_time();
+  } else if(p->sched->id == SCHED_STRIDE){
+    p->pass = c->rq.vpass;
+  }
+  release(&c->rq.lock);
+}
+
+// Move p to class cl, requeueing it if it is queued.
+// Caller must hold p->lock.
+static void
+setclass(struct proc *p, struct sched_class *cl)
+{
+  struct runq *rq;
+  struct cpu *c;
+
+  if(p->sched->id == SCHED_EDF && cl != p->sched)
+    edf_leave(p);
+  if((rq = p->rq) == 0){
+    p->sched = cl;
+    if(p->state == RUNNING){
+      for(c = cpus; c < &cpus[NCPU]; c++)
+        if(c->proc == p)
+          sched_rejoin(c, p);
+    } else if(p->state == RUNNABLE){
+      // picked by a scheduler that is waiting for p->lock
+      // to switch to it; runproc() does the rejoin.
+      p->rejoin = 1;
+    }
+    return;
+  }
+  acquire(&rq->lock);
+  runq_remove(rq, p, 1);
+  p->sched = cl;
+  runq_insert(rq, p, 1);
+  release(&rq->lock);
+}
+
+// Put process pid in scheduling class id; if pid is 0, put
+// every process in it and make it the class new processes
+// start in. A negative id changes nothing. Returns the
+// previous class, or -1.
+int
+setscheduler(int pid, int id)
 {
+  struct sched_class *cl = 0;
   struct proc *p;
-  int old_priority = -1;
-  for(p = proc; p < &proc[NPROC]; p++){
-    int flag = 0;
-    acquire(&p->lock);
-    if(p->pid == pid){
-      old_priority = p->static_priority;
-      p->static_priority = priority;
-      p->run_ticks = 0;
-      p->sleep_ticks = 0;
-      if(p->static_priority < old_priority){
-        flag = 1;
-      }
+  int old = -1;
 
+  // EDF needs parameters, see setdeadline().
+  if(id >= 0 && ((cl = sched_lookup(id)) == 0 || id == SCHED_EDF))
+    return -1;
+  if(pid == 0){
+    old = sched_default->id;
+    if(cl == 0)
+      return old;
+    sched_default = cl;
+    for(int i = 0; i < nprocs; i++){
+      p = procs[i];
+      acquire(&p->lock);
+      if(p->state != UNUSED)
+        setclass(p, cl);
       release(&p->lock);
-      if(flag == 1){
-        yield();
-      }
-      return old_priority;
     }
+  } else {
+    if((p = findproc(pid)) == 0)
+      return -1;
+    old = p->sched->id;
+    if(cl)
+      setclass(p, cl);
     release(&p->lock);
   }
-  return old_priority;
+  if(resched_pending())
+    yield();
+  return old;
 }
 
+// Copy the statistics of scheduling class id out to user
+// address addr.
+int
+classstat(int id, uint64 addr)
+{
+  struct classstat st;
+  struct sched_class *cl;
+  struct proc *p;
 
+  if((cl = sched_lookup(id)) == 0)
+    return -1;
+  safestrcpy(st.name, cl->name, sizeof(st.name));
+  st.nproc = 0;
+  for(int i = 0; i < nprocs; i++){
+    p = procs[i];
+    if(p->state != UNUSED && p->sched == cl)
+      st.nproc++;
+  }
+  st.nswitch = cl->nswitch;
+  st.runtime = cl->runtime;
+  st.npreempt = cl->npreempt;
+  if(copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
 
+// Put process pid in the EDF class: every period ticks it
+// may run for runtime ticks, due deadline ticks after the
+// start of the period. runtime 0 takes it out of the class
+// again. Fails if the parameters are not 0 < runtime <=
+// deadline <= period, or if no cpu has the bandwidth left.
+int
+setdeadline(int pid, int runtime, int deadline, int period)
+{
+  struct proc *p;
+  struct runq *rq;
+  struct cpu *c, *home = 0;
+  uint64 bw = 0, now;
 
-// queue functions using ll
-// struct que
-// *que_init(void){
-//     struct que *que = (struct que *)kalloc();
-//     que->head = 0;
-//     que->tail = 0;
-//     que->size = 0;
-//     return que;
-// }
-
-// void
-// que_push(struct que *que, struct proc *proc){
-//     struct que_node *node = (struct que_node *)kalloc();
-//     // printf("pushing in  %d\n",proc->curr_q);
-//     node->proc = proc;
-//     node->next = 0;
-//     if(que->head == 0){
-//         que->head = node;
-//         que->tail = node;
-//     }else{
-//         que->tail->next = node;
-//         que->tail = node;
-//     }
-//     que->size++;
-// }
+  if(runtime < 0 || (runtime > 0 && (deadline < runtime || period < deadline)))
+    return -1;
+  if(runtime > 0)
+    bw = (uint64)runtime * EDF_BWONE / period;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  if(p->state == ZOMBIE){
+    release(&p->lock);
+    return -1;
+  }
 
-// struct proc
-// *que_pop(struct que *que){
-//     if(que->head == 0){
-//         return 0;
-//     }
-//     struct que_node *node = que->head;
-//     struct proc *proc = node->proc;
-//     que->head = node->next;
-//     if(que->head == 0){
-//         que->tail = 0;
-//     }
-//     kfree((void *)node);
-//     que->size--;
-//     return proc;
-// }
+  // admit p to the first cpu with room, trying the one it
+  // is on already first.
+  acquire(&dl_lock);
+  if(p->sched->id == SCHED_EDF)
+    cpus[p->dl_cpu].rq.dl_bw -= p->dl_bw;
+  if(bw){
+    if(p->sched->id == SCHED_EDF && cpus[p->dl_cpu].rq.dl_bw + bw <= EDF_MAXBW)
+      home = &cpus[p->dl_cpu];
+    for(c = cpus; home == 0 && c < &cpus[NCPU]; c++)
+      if(c->started && runq_allowed(p, c) && c->rq.dl_bw + bw <= EDF_MAXBW)
+        home = c;
+    if(home == 0){
+      if(p->sched->id == SCHED_EDF)
+        cpus[p->dl_cpu].rq.dl_bw += p->dl_bw;
+      release(&dl_lock);
+      release(&p->lock);
+      return -1;
+    }
+    home->rq.dl_bw += bw;
+  }
+  release(&dl_lock);
 
-// struct proc
-// *que_front(struct que *que){
-//     if(que->head == 0){
-//         return 0;
-//     }
-//     return que->head->proc;
-// }
+  // requeue p in its new class.
+  if((rq = p->rq) != 0){
+    acquire(&rq->lock);
+    runq_remove(rq, p, 1);
+    release(&rq->lock);
+  }
+  if(bw){
+    now = r_time();
+    p->sched = sched_lookup(SCHED_EDF);
+    p->dl_runtime = (uint64)runtime * tick_cycles;
+    p->dl_deadline = (uint64)deadline * tick_cycles;
+    p->dl_period = (uint64)period * tick_cycles;
+    p->dl_bw = bw;
+    p->dl_cpu = home - cpus;
+    p->dl_release = p->dl_exec = now;
+    p->dl_abs = now + p->dl_deadline;
+    p->dl_budget = p->dl_runtime;
+    p->dl_throttled = 0;
+    p->dl_missed = 0;
+    p->dl_njobs = 1;
+    p->dl_nmiss = 0;
+    p->dl_nthrottle = 0;
+    if(rq)
+      rq = &home->rq;
+    // a running p moves to its cpu when it next yields.
+    for(c = cpus; c < &cpus[NCPU]; c++)
+      if(c->proc == p && c != home)
+        resched(c);
+  } else if(p->sched->id == SCHED_EDF){
+    p->dl_bw = 0;
+    p->sched = sched_default;
+  }
+  if(rq)
+    runq_add(rq, p, 1);
+  release(&p->lock);
+  return 0;
+}
 
-// int
-// que_empty(struct que *que){
-//     return que->head == 0;
-// }
+// Copy process pid's EDF parameters and counters out to
+// user address addr.
+int
+deadlinestat(int pid, uint64 addr)
+{
+  struct dlstat st;
+  struct proc *p;
 
-// void
-// que_pushfront(struct que *que, struct proc *proc){
-//     struct que_node *node = (struct que_node *)kalloc();
-//     // printf("pushfront in %d\n", proc->curr_q);
-//     node->proc = proc;
-//     node->next = que->head;
-//     que->head = node;
-//     if(que->tail == 0){
-//         que->tail = node;
-//     }
-//     que->size++;
-// }
+  if((p = findproc(pid)) == 0)
+    return -1;
+  st.runtime = st.deadline = st.period = 0;
+  if(p->sched->id == SCHED_EDF){
+    st.runtime = p->dl_runtime / tick_cycles;
+    st.deadline = p->dl_deadline / tick_cycles;
+    st.period = p->dl_period / tick_cycles;
+  }
+  st.cpu = p->dl_cpu;
+  st.njobs = p->dl_njobs;
+  st.nmiss = p->dl_nmiss;
+  st.nthrottle = p->dl_nthrottle;
+  release(&p->lock);
+  if(copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
 
-// void
-// que_remove(struct que *que, struct proc *proc){
-//     struct que_node *node = que->head;
-//     struct que_node *prev = 0;
-//     while(node != 0){
-//         if(node->proc == proc){
-//             if(prev == 0){
-//                 que->head = node->next;
-//             }else{
-//                 prev->next = node->next;
-//             }
-//             if(node->next == 0){
-//                 que->tail = prev;
-//             }
-//             kfree((void *)node);
-//             que->size--;
-//             return;
-//         }
-//         prev = node;
-//         node = node->next;
-//     }
-//     que->size--;
-// }
+// Let process pid run only on the cpus in mask, bit i for
+// cpus[i]. If it is queued or running on another cpu, it
+// moves now. An EDF process must keep the cpu it was
+// admitted to. Returns 0, or -1 if no cpu in mask is
+// scheduling.
+int
+setaffinity(int pid, uint64 mask)
+{
+  struct proc *p;
+  struct runq *rq;
+  struct cpu *c;
 
+  mask &= CPUMASK_ALL;
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c->started && ((mask >> (c - cpus)) & 1))
+      break;
+  if(c == &cpus[NCPU])
+    return -1;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  if(p->state == ZOMBIE){
+    release(&p->lock);
+    return -1;
+  }
+  if(p->sched->id == SCHED_EDF && ((mask >> p->dl_cpu) & 1) == 0){
+    release(&p->lock);
+    return -1;
+  }
+  p->cpumask = mask;
+  if((rq = p->rq) != 0 && !runq_allowed(p, rq->cpu)){
+    acquire(&rq->lock);
+    runq_remove(rq, p, 1);
+    release(&rq->lock);
+    runq_add(&runq_select(p)->rq, p, 1);
+  }
+  // a running p moves when it next yields.
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c->proc == p && !runq_allowed(p, c))
+      resched(c);
+  release(&p->lock);
+  return 0;
+}
 
+// Copy process pid's affinity mask out to user address addr.
+int
+getaffinity(int pid, uint64 addr)
+{
+  struct proc *p;
+  uint64 mask;
 
-// queue functions using array
-struct que
-*que_init(void){
-    struct que *que = (struct que *)kalloc();
-    que->head = 0;
-    que->tail = 0;
-    que->size = 0;
-    return que;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  mask = p->cpumask;
+  release(&p->lock);
+  if(copyout(myproc()->pagetable, addr, (char *)&mask, sizeof(mask)) < 0)
+    return -1;
+  return 0;
 }
 
-void
-que_push(struct que *que, struct proc *proc){
-    // printf("pushing in  %d\n",proc->curr_q);
-    if(que->size == 0){
-        que->head = 0;
-        que->tail = 0;
-    }
-    que->procs[que->tail] = proc;
-    que->tail = (que->tail + 1) % NPROC;
-    que->size++;
-}
+// Copy process pid's latency histograms out to user address
+// addr. A zombie's are kept until it is reaped.
+int
+schedhist(int pid, uint64 addr)
+{
+  struct schedhist h;
+  struct proc *p;
 
-struct proc
-*que_pop(struct que *que){
-    if(que->size == 0){
-        return 0;
-    }
-    struct proc *proc = que->procs[que->head];
-    que->head = (que->head + 1) % NPROC;
-    que->size--;
-    return proc;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  h.sched = p->sched->id;
+  safestrcpy(h.name, p->name, sizeof(h.name));
+  memmove(h.count, p->hist, sizeof(p->hist));
+  memmove(h.max, p->hist_max, sizeof(p->hist_max));
+  release(&p->lock);
+  if(copyout(myproc()->pagetable, addr, (char *)&h, sizeof(h)) < 0)
+    return -1;
+  return 0;
 }
 
-struct proc
-*que_front(struct que *que){
-    if(que->size == 0){
-        return 0;
+// Copy the MLFQ tunables and the promotion and demotion
+// counters of all cpus out to user address get, then
+// replace the tunables with those at set. Either address
+// may be 0.
+int
+mlfqctl(uint64 get, uint64 set)
+{
+  struct proc *p = myproc();
+  struct mlfqstat old, st;
+  struct cpu *c;
+  int q;
+
+  old.aging = mlfq_aging;
+  for(q = 0; q < MLFQ_LEVELS; q++){
+    old.quantum[q] = mlfq_quantum[q];
+    old.promote[q] = old.demote[q] = 0;
+    for(c = cpus; c < &cpus[NCPU]; c++){
+      old.promote[q] += c->rq.promote[q];
+      old.demote[q] += c->rq.demote[q];
     }
-    return que->procs[que->head];
+  }
+  if(set){
+    if(copyin(p->pagetable, (char *)&st, set, sizeof(st)) < 0)
+      return -1;
+    if(st.aging < 1)
+      return -1;
+    for(q = 0; q < MLFQ_LEVELS; q++)
+      if(st.quantum[q] < 1)
+        return -1;
+    mlfq_aging = st.aging;
+    for(q = 0; q < MLFQ_LEVELS; q++)
+      mlfq_quantum[q] = st.quantum[q];
+  }
+  if(get && copyout(p->pagetable, get, (char *)&old, sizeof(old)) < 0)
+    return -1;
+  return 0;
 }
 
 int
-que_empty(struct que *que){
-    return que->size == 0;
-}
+set_priority(int priority, int pid)
+{
+  struct proc *p;
+  int old_priority = -1;
+  int flag = 0;
 
-void
-que_pushfront(struct que *que, struct proc *proc){
-    // printf("pushfront in %d\n", proc->curr_q);
-    if(que->size == 0){
-        que->head = 0;
-        que->tail = 0;
+  if((p = findproc(pid)) == 0)
+    return old_priority;
+  old_priority = p->static_priority;
+  p->static_priority = priority;
+  p->run_time = 0;
+  p->sleep_time = 0;
+  if(p->static_priority < old_priority){
+    flag = 1;
+  }
+  struct runq *rq = p->rq;
+  if(rq && p->sched->id == SCHED_PBS){
+    acquire(&rq->lock);
+    p->pbs_dp = dynamic_priority(p);
+    heap_fix(&rq->pbsq, p, pbs_less);
+#ifdef PREEMPT
+    pbs_check_preempt(rq);
+#endif
+    release(&rq->lock);
+  }
+  if(rq && p->sched->id == SCHED_CFS){
+    acquire(&rq->lock);
+    rq->cfs_load += cfs_weight(p) - p->cfs_weight;
+    p->cfs_weight = cfs_weight(p);
+    release(&rq->lock);
+  }
+#ifdef PREEMPT
+  // preempt the cpu running p if it is now beaten
+  // by a process queued there.
+  if(rq == 0 && p->state == RUNNING && p->sched->id == SCHED_PBS){
+    for(struct cpu *c = cpus; c < &cpus[NCPU]; c++){
+      if(c->proc == p){
+        acquire(&c->rq.lock);
+        pbs_check_preempt(&c->rq);
+        release(&c->rq.lock);
+      }
     }
-    que->head = (que->head - 1 + NPROC) % NPROC;
-    que->procs[que->head] = proc;
-    que->size++;
-}
+  }
+  flag = 0;
+#endif
 
+  release(&p->lock);
+  if(flag == 1){
+    yield();
+  }
+  if(resched_pending())
+    yield();
+  return old_priority;
+}
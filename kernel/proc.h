@@ -18,12 +18,130 @@ struct context {
   uint64 s11;
 };
 
+#define HEAPPG 512   // entries in a page of a procheap
+#define TIXPG 1024   // nodes in a page of a Fenwick tree
+
+// Binary min-heap of processes; p->heap_idx is p's index.
+// The array is kept in pages, added by procgrow() as the
+// process table grows.
+struct procheap {
+  struct proc **pg[(NPROC + HEAPPG - 1) / HEAPPG];
+  int n;
+};
+
+// Entry i of heap h, and node i, 1 <= i <= rq->tixcap, of
+// run queue rq's Fenwick tree.
+#define HEAP(h, i) ((h)->pg[(i) / HEAPPG][(i) % HEAPPG])
+#define TIX(rq, i) ((rq)->tix[((i)-1) / TIXPG][((i)-1) % TIXPG])
+
+struct cpu;
+
+// List of queued processes, linked through p->rq_next
+// and p->rq_prev.
+struct plist {
+  struct proc *head;
+  struct proc *tail;
+};
+
+struct runq;
+
+// Processes sleeping on the channels that hash to one
+// bucket, oldest first, linked through p->wq_next and
+// p->wq_prev.
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+  struct proc *tail;
+};
+
+// A scheduling policy. Each cpu's run queue holds processes
+// of every class; the scheduler runs the pick of the first
+// class in sched_classes[] that has one, so earlier classes
+// take precedence. rq->lock is held across enqueue, dequeue
+// and pick_next.
+struct sched_class {
+  int id;                     // SCHED_* in schedstat.h
+  char *name;
+  // Queue p on rq. join is 0 if p was just running on rq's cpu.
+  void (*enqueue)(struct runq *rq, struct proc *p, int join);
+  // Take p off rq. leave is set if p moves to another cpu.
+  void (*dequeue)(struct runq *rq, struct proc *p, int leave);
+  // The queued process to run next, or 0. The caller
+  // dequeues it and runs it.
+  struct proc *(*pick_next)(struct runq *rq);
+  // Timer interrupt while p runs. Returns 1 to preempt p.
+  int (*tick)(struct proc *p);
+  // p gives up its cpu, to rq if it yields, or to sleep. May be 0.
+  void (*yield_hook)(struct runq *rq, struct proc *p, int sleeping);
+  // The mtime at which the running p's slice runs out, so
+  // tick() can be called then rather than at the next clock
+  // tick; 0 if there is no such time. May be 0.
+  uint64 (*slice_end)(struct proc *p);
+  uint64 nswitch;             // Switches to processes of this class
+  uint64 runtime;             // mtime run by processes of this class
+  uint64 npreempt;            // Times tick() preempted one of them
+};
+
+// Per-CPU queue of RUNNABLE processes. Every queued process
+// is on all, linked through p->rq_next and p->rq_prev, and in
+// the structure of its class. Only the processes waiting for
+// this cpu are on it, so picking one does not have to look
+// at the rest of the process table.
+struct runq {
+  struct spinlock lock;
+  struct cpu *cpu;            // The cpu this queue feeds.
+  struct plist all;           // Queued processes of every class, oldest first.
+  struct plist rr;            // RR: queued processes in arrival order.
+  struct plist fcfs;          // FCFS: queued processes by creation time.
+  struct plist mlfq[MLFQ_LEVELS]; // MLFQ: queued processes by level.
+  uint mlfq_ready;            // MLFQ: bit q set iff mlfq[q] is non-empty.
+  struct proc *agewheel[AGEWHEEL]; // MLFQ: processes below level 0, by age_deadline.
+  int naging;                 // MLFQ: processes on agewheel.
+  uint age_clock;             // MLFQ: tick agewheel has been advanced to.
+  uint64 promote[MLFQ_LEVELS]; // MLFQ: promotions out of each level.
+  uint64 demote[MLFQ_LEVELS];  // MLFQ: demotions out of each level.
+  int size;                   // Number of processes on the queue.
+  int ntickets;               // LBS: tickets of the queued processes.
+  int *tix[2*NPROC/TIXPG + 1]; // LBS: Fenwick tree of tickets by proc slot, in pages,
+  int tixcap;                 // LBS: and its size, a power of two >= nprocs.
+  struct procheap strideq;    // Stride scheduling: queued processes by pass.
+  uint64 vpass;               // Stride scheduling: pass of the last pick.
+  struct proc *cfs_root;      // CFS: red-black tree of queued processes by vruntime.
+  struct proc *cfs_min;       // CFS: leftmost node of cfs_root.
+  uint64 min_vruntime;        // CFS: lowest vruntime here, never decreases.
+  uint64 cfs_load;            // CFS: sum of the queued processes' weights.
+  struct procheap pbsq;       // PBS: queued processes by pbs_less().
+  struct procheap edfq;       // EDF: queued processes with budget, by deadline.
+  struct plist dl_throttled;  // EDF: queued processes out of budget.
+  int ndl_throttled;          // EDF: processes on dl_throttled.
+  uint64 dl_bw;               // EDF: bandwidth admitted to this cpu, dl_lock.
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct runq rq;             // RUNNABLE processes waiting for this cpu.
+  int started;                // Has this cpu entered scheduler()?
+  uint64 nswitch;             // Processes switched to.
+  uint64 nsteal;              // Processes stolen while idle.
+  uint64 nmigrate;            // Processes moved here from another cpu.
+  uint64 rand_next;           // State of this cpu's rand().
+  int need_resched;           // A better process was queued; preempt proc.
+  uint64 next_tick;           // mtime of this cpu's next clock tick.
+  uint64 slice_end;           // mtime proc's slice runs out, or 0.
+  int idle;                   // Waiting for an interrupt in wfi?
+  uint64 kstack_gen;          // kstack_gen when its TLB was last flushed.
+  uint64 flush_req;           // TLB flushes asked of it by tlbshootdown(),
+  uint64 flush_done;          // and the last one it has done.
+  uint64 idle_time;           // mtime spent idle.
+  uint64 nwakeup;             // Woken processes run here,
+  uint64 wakelat;             // their total and
+  uint64 wakelat_max;         // longest wait to run, in mtime.
+  uint hist[NHISTS][NHIST];   // Latency histograms of state changes made here,
+  uint64 hist_max[NHISTS];    // and their longest times; see schedhist().
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,6 +199,24 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// What the threads of a process share. Every thread holds a
+// reference; the page table goes with the last one.
+struct tgroup {
+  struct spinlock lock;
+
+  // lock must be held when using these:
+  int ref;                     // Threads not yet freed
+  int nlive;                   // Threads not yet exited
+  uint64 sz;                   // Size of process memory (bytes)
+  uint32 tfslots;              // Trapframe pages in use, see UTRAPFRAME
+  struct proc *futexq;         // Threads in futex_wait(), via futex_next
+  struct file *ofile[NOFILE];  // Open files
+  struct inode *cwd;           // Current directory
+
+  struct proc *members;        // Threads not yet exited, under wait_lock
+  struct tgroup *next;         // Next unused tgroup, under proc_lock
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -92,17 +228,33 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // Its live children, through sib_next
+  struct proc *zombies;        // Its exited children, not yet waited for
+  struct proc *threads;        // Its live threads, see clone()
+  struct proc *tzombies;       // Its exited threads, not yet joined
+  struct proc *sib_next;       // Next on parent's children or zombies
+  struct proc *sib_prev;
+  int thread;                  // Made by clone(), so joined, not waited for
+  struct proc *tg_next;        // Next on tg->members
+  struct proc *tg_prev;
+
+  // proc_lock must be held when using these:
+  struct proc *pid_next;       // Next proc in its pidhash bucket
+  struct proc *free_next;      // Next unused proc
+  int slot;                    // Index in procs[]; never changes
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;                      // Virtual address of kernel stack
-  uint64 sz;                          // Size of process memory (bytes)
-  pagetable_t pagetable;              // User page table
+  struct tgroup *tg;                  // Memory, files and cwd
+  pagetable_t pagetable;              // User page table, tg's
   struct trapframe *trapframe;        // data page for trampoline.S
+  uint64 tfva;                        // User address of trapframe
+  uint64 futex;                       // Futex slept on, under tg->lock
+  struct proc *futex_next;            // Next on tg->futexq
+  struct proc *futex_prev;
   struct context context;             // swtch() here to run process
-  struct file *ofile[NOFILE];         // Open files
-  struct inode *cwd;                  // Current directory
   char name[16];                      // Process name (debugging)
   uint32 mask;                        // signal to trace mask
   uint64 alarm_ticks;                 // alarm time
@@ -112,48 +264,91 @@ struct proc {
   void (*alarm_handler)(void);        // default alarm handler
   uint64 a0_backup;                   // backup a0_register
 
+  struct sched_class *sched;          // Scheduling class
+  int rejoin;                         // picked, but changed class since; see setclass()
+
 // FCFS
   uint64 start_ticks;                 // start time
 
 // Lottery scheduling
   int tickets;                        // tickets for lottery scheduler
 
+// Stride scheduling
+  uint64 stride;                      // STRIDE1 / tickets
+  uint64 pass;                        // virtual time, lowest runs next
+  uint64 pass_remain;                 // pass ahead of the queue's vpass when not queued
+
+// CFS
+  uint64 vruntime;                    // run time scaled by weight, lowest runs next
+  long vlag;                          // vruntime ahead of the queue's min when not queued
+  uint64 cfs_slept;                   // mtime p went to sleep, or 0
+  uint64 exec_start;                  // mtime p was last charged vruntime
+  uint64 slice_start;                 // mtime p was last picked
+  int cfs_weight;                     // weight while queued
+
+// EDF, times in mtime cycles
+  uint64 dl_runtime;                  // budget per period
+  uint64 dl_deadline;                 // deadline of each job after its release
+  uint64 dl_period;                   // period
+  uint64 dl_bw;                       // runtime / period, EDF_BWONE is all of a cpu
+  int dl_cpu;                         // cpu p was admitted to, and runs on
+  uint64 dl_release;                  // release of the current job
+  uint64 dl_abs;                      // absolute deadline of the current job
+  long dl_budget;                     // runtime left to the current job
+  uint64 dl_exec;                     // when the budget was last charged
+  int dl_throttled;                   // out of budget until the next release
+  int dl_missed;                      // current job has missed its deadline
+  uint64 dl_njobs;                    // jobs released
+  uint64 dl_nmiss;                    // jobs that missed their deadline
+  uint64 dl_nthrottle;                // times throttled
+
 // PBS variables
-  uint64 run_ticks;                   // run time from last time it was scheduled
-  uint64 sleep_ticks;                 // sleep time from last time it was scheduled
-  uint64 ready_ticks;                 // ready time from last time it was scheduled
+  uint64 run_time;                    // mtime run since last scheduled
+  uint64 sleep_time;                  // mtime slept since last scheduled
+  uint64 ready_time;                  // mtime spent RUNNABLE
   uint64 num_scheduled;               // number of times it was scheduled
   int static_priority;                // static priority
+  int pbs_dp;                         // dynamic priority when queued
 
 
-// waitx variables
-  uint rtime;                   // How long the process ran for
-  uint ctime;                   // When was the process created
-  uint etime;
+// accounting, in mtime cycles; charged by setstate()
+  uint64 state_time;            // When p was last charged, see charge()
+  uint64 rtime;                 // How long the process ran for
+  uint64 ctime;                 // When was the process created
+  uint64 etime;                 // When did the process exit
+  uint64 wake_time;             // When setrunnable() queued it, 0 once it runs
+  uint64 state_enter;           // When p entered its current state
+  uint hist[NHISTS][NHIST];     // Latency histograms, see schedhist()
+  uint64 hist_max[NHISTS];      // Longest time in each
 
 //mlfq variables
   int curr_q;                   // Current queue of the process
-  uint64 q_ticks[5];            // Ticks in each queue
-  uint64 cq_rticks;             // RunTicks in current queue after last switch
+  uint64 q_time[5];             // mtime run in each queue
+  uint64 cq_rtime;              // mtime run in current queue since queued
   uint64 q_enter_time;          // Time when the process entered the queue
-  uint64 qued_fl  ;             // Flag to check if the process is qued
-
-};
 
+// wait queue of p->chan, its lock must be held when using these:
+  struct proc *wq_next;         // Next process on the wait queue
+  struct proc *wq_prev;         // Previous process on the wait queue
 
-
-struct que {
-  int head;
-  int tail;
-  int size;
-  struct proc *procs[NPROC];
+// run queue, rq->lock must be held when using these:
+  struct runq *rq;              // Run queue p is on, or 0
+  struct proc *rq_next;         // Next process on rq
+  struct proc *rq_prev;         // Previous process on rq
+  struct proc *cl_next;         // Next process on p's class list
+  struct proc *cl_prev;         // Previous process on p's class list
+  struct proc *rb_child[2];     // Left and right child in rq's CFS tree
+  struct proc *rb_parent;       // Parent in rq's CFS tree
+  int rb_red;                   // Colour in rq's CFS tree
+  int rq_tickets;               // Tickets p holds in rq's lottery
+  int heap_idx;                 // Index of p in a run queue heap
+  uint age_deadline;            // MLFQ: tick at which p is promoted
+  struct proc *age_next;        // Next process in p's agewheel slot
+  struct proc *age_prev;        // Previous process in p's agewheel slot
+  uint64 last_run;              // ticks when p last stopped running
+  uint64 migrations;            // Times p moved to another cpu
+  int last_cpu;                 // cpu p last ran on, or -1
+  uint64 cpumask;               // cpus p may run on, bit i for cpus[i]
+  int slice_ticks;              // Ticks run since last scheduled
 };
 
-struct que *que_init(void);
-void que_push(struct que *que, struct proc *proc);
-struct proc *que_pop(struct que *que);
-struct proc *que_front(struct que *que);
-int que_empty(struct que *que);
-void que_pushfront(struct que *que, struct proc *proc);
-
-
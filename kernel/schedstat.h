@@ -0,0 +1,84 @@
+// Scheduling classes, see setscheduler().
+#define SCHED_RR     0
+#define SCHED_FCFS   1
+#define SCHED_LBS    2
+#define SCHED_PBS    3
+#define SCHED_MLFQ   4
+#define SCHED_STRIDE 5
+#define SCHED_CFS    6
+#define SCHED_EDF    7
+#define NSCHED       8
+
+// Latency histograms, see schedhist(). Bucket i counts the
+// times that took from 2^i up to 2^(i+1) mtime cycles; the
+// first also counts 0 and the last everything longer.
+#define HIST_WAIT  0 // RUNNABLE until RUNNING
+#define HIST_SLICE 1 // RUNNING until it stopped
+#define HIST_SLEEP 2 // SLEEPING until woken
+
+struct schedhist {
+  int sched;                  // Class of the process, SCHED_*
+  char name[16];
+  uint count[NHISTS][NHIST];
+  uint64 max[NHISTS];         // Longest time seen, mtime cycles
+};
+
+// Scheduler events, see schedtrace().
+#define SEV_ENQUEUE 1 // pid queued on cpu
+#define SEV_DEQUEUE 2 // pid taken off cpu's queue to run or move
+#define SEV_SWITCH  3 // cpu switched to pid
+#define SEV_LEVEL   4 // pid demoted to MLFQ level
+#define SEV_AGE     5 // pid promoted to MLFQ level by aging
+#define SEV_LOST    6 // a ring overflowed: pid events lost on cpu
+
+struct schedev {
+  uint64 time;  // rdtime, mtime cycles
+  int pid;
+  uchar type;   // SEV_*
+  uchar cpu;
+  uchar sched;  // Class of the process, SCHED_*
+  uchar level;  // Its MLFQ level
+};
+
+// Per-CPU scheduler statistics, filled in by schedstat().
+struct schedstat {
+  int started;     // Has the cpu entered scheduler()?
+  int nrunnable;   // Processes on its run queue
+  uint64 nswitch;  // Processes switched to
+  uint64 nsteal;   // Processes stolen from other cpus while idle
+  uint64 nmigrate; // Processes moved here by stealing or rebalancing
+  uint64 idletime; // mtime cycles spent idle in wfi
+  uint64 nwakeup;  // Woken or new processes it ran
+  uint64 wakelat;  // Their total wait from wakeup to running, mtime cycles
+  uint64 wakelatmax; // The longest such wait since the last schedstat()
+  struct schedhist hist; // State changes made on the cpu
+};
+
+// MLFQ tunables and counters, see mlfqctl().
+struct mlfqstat {
+  int aging;                    // Ticks waited on a level before promotion
+  int quantum[MLFQ_LEVELS];     // Ticks run on a level before demotion
+  uint64 promote[MLFQ_LEVELS];  // Promotions out of each level, all cpus
+  uint64 demote[MLFQ_LEVELS];   // Demotions out of each level, all cpus
+};
+
+// Per-class statistics, filled in by classstat().
+struct classstat {
+  char name[16];
+  int nproc;       // Processes in the class
+  uint64 nswitch;  // Times one of them was switched to
+  uint64 runtime;  // mtime cycles they ran
+  uint64 npreempt; // Times one was preempted by a clock tick
+};
+
+// A process's EDF parameters, in ticks, and counters, filled
+// in by deadlinestat().
+struct dlstat {
+  int runtime;      // Budget per period, 0 if not in the EDF class
+  int deadline;     // Deadline of each job after its release
+  int period;
+  int cpu;          // The cpu it was admitted to
+  uint64 njobs;     // Jobs released
+  uint64 nmiss;     // Jobs that still wanted the cpu after their deadline
+  uint64 nthrottle; // Times it was throttled for using up its budget
+};
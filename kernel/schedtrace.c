@@ -0,0 +1,128 @@
+// Scheduler event trace.
+//
+// Each cpu records scheduler events (see SEV_* in
+// schedstat.h) in a ring of its own, stamped with rdtime.
+// Only that cpu writes its ring, with interrupts off, so
+// recording takes no lock: it fills the next slot, then
+// publishes it by advancing head. A reader copies events
+// out, then checks head again and drops those the writer
+// may have overwritten in the meantime. While tracing is
+// off, each event point costs one load of trace_on.
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "schedstat.h"
+#include "defs.h"
+
+int trace_on;
+
+struct ring {
+  struct schedev ev[TRACE_RING];
+  uint64 head;                  // events ever written
+  uint64 tail;                  // events ever read, under rings.lock
+};
+
+struct {
+  struct spinlock lock;         // serializes readers
+  struct ring ring[NCPU];
+} rings;
+
+void
+schedtraceinit(void)
+{
+  initlock(&rings.lock, "trace");
+}
+
+// Record an event about process pid, which is on cpu or
+// has level as its MLFQ level, in this cpu's ring.
+void
+trace_event(int type, int cpu, int pid, int sched, int level)
+{
+  struct ring *r;
+  struct schedev *e;
+
+  push_off();
+  r = &rings.ring[cpuid()];
+  e = &r->ev[r->head % TRACE_RING];
+  e->time = r_time();
+  e->pid = pid;
+  e->type = type;
+  e->cpu = cpu;
+  e->sched = sched;
+  e->level = level;
+  __sync_synchronize();
+  r->head++;
+  pop_off();
+}
+
+// Turn tracing on (1) or off (0), or leave it (-1), then
+// move up to n events from the cpus' rings to user address
+// addr. Turning it on discards what was recorded before.
+// Where a ring overflowed, a SEV_LOST event, with the count
+// in pid, stands for the events that were lost. Returns the
+// number of events copied, or -1 on error or, like the end
+// of a file, once tracing is off and every ring is empty.
+int
+schedtrace(int on, uint64 addr, int n)
+{
+  struct schedev buf[32];
+  struct ring *r;
+  uint64 h, i, lost;
+  int got = 0, k, drop, m;
+
+  acquire(&rings.lock);
+  if(on == 1 && !trace_on)
+    for(r = rings.ring; r < &rings.ring[NCPU]; r++)
+      r->tail = r->head;
+  if(on >= 0)
+    trace_on = on;
+  for(r = rings.ring; r < &rings.ring[NCPU]; r++){
+    // buf[0] is kept for a SEV_LOST event.
+    while(got < n - 1 && r->tail != (h = r->head)){
+      __sync_synchronize();
+      // while head is h the writer may be filling slot
+      // h % TRACE_RING, so event h - TRACE_RING is gone too.
+      lost = 0;
+      if(h + 1 - r->tail > TRACE_RING){
+        lost = h + 1 - TRACE_RING - r->tail;
+        r->tail = h + 1 - TRACE_RING;
+      }
+      k = 0;
+      for(i = r->tail; i < h && k < NELEM(buf) - 1 && got + k < n - 1; i++)
+        buf[1 + k++] = r->ev[i % TRACE_RING];
+      // the writer may have overwritten the oldest while
+      // they were copied.
+      __sync_synchronize();
+      h = r->head;
+      drop = 0;
+      if(h + 1 > r->tail + TRACE_RING)
+        drop = h + 1 - TRACE_RING - r->tail < k ? h + 1 - TRACE_RING - r->tail : k;
+      r->tail += k;
+      lost += drop;
+      m = k - drop;
+      if(lost){
+        memset(&buf[drop], 0, sizeof(buf[0]));
+        buf[drop].time = r_time();
+        buf[drop].type = SEV_LOST;
+        buf[drop].cpu = r - rings.ring;
+        buf[drop].pid = lost;
+        m++;
+      } else {
+        drop++;
+      }
+      if(copyout(myproc()->pagetable, addr + got * sizeof(buf[0]),
+                 (char *)&buf[drop], m * sizeof(buf[0])) < 0){
+        release(&rings.lock);
+        return -1;
+      }
+      got += m;
+    }
+  }
+  if(got == 0 && !trace_on)
+    got = -1;
+  release(&rings.lock);
+  return got;
+}
@@ -12,7 +12,7 @@ int
 fetchaddr(uint64 addr, uint64 *ip)
 {
   struct proc *p = myproc();
-  if(addr >= p->sz || addr+sizeof(uint64) > p->sz) // both tests needed, in case of overflow
+  if(addr >= p->tg->sz || addr+sizeof(uint64) > p->tg->sz) // both tests needed, in case of overflow
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
@@ -107,6 +107,22 @@ extern uint64 sys_sigreturn(void);
 extern uint64 sys_settickets(void);
 extern uint64 sys_waitx(void);
 extern uint64 sys_setpriority(void);
+extern uint64 sys_schedstat(void);
+extern uint64 sys_mlfqctl(void);
+extern uint64 sys_setscheduler(void);
+extern uint64 sys_classstat(void);
+extern uint64 sys_setdeadline(void);
+extern uint64 sys_deadlinestat(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_settickrate(void);
+extern uint64 sys_setaffinity(void);
+extern uint64 sys_getaffinity(void);
+extern uint64 sys_schedhist(void);
+extern uint64 sys_schedtrace(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -138,6 +154,22 @@ static uint64 (*syscalls[])(void) = {
 [SYS_settickets] sys_settickets,
 [SYS_waitx] sys_waitx,
 [SYS_setpriority] sys_setpriority,
+[SYS_schedstat] sys_schedstat,
+[SYS_mlfqctl] sys_mlfqctl,
+[SYS_setscheduler] sys_setscheduler,
+[SYS_classstat] sys_classstat,
+[SYS_setdeadline] sys_setdeadline,
+[SYS_deadlinestat] sys_deadlinestat,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_settickrate] sys_settickrate,
+[SYS_setaffinity] sys_setaffinity,
+[SYS_getaffinity] sys_getaffinity,
+[SYS_schedhist] sys_schedhist,
+[SYS_schedtrace] sys_schedtrace,
+[SYS_clone] sys_clone,
+[SYS_join] sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
 };
 
 
@@ -171,6 +203,22 @@ char* syscallnames[] = {
   [SYS_settickets] "settickets",
   [SYS_waitx] "waitx",
   [SYS_setpriority] "setpriority",
+  [SYS_schedstat] "schedstat",
+  [SYS_mlfqctl] "mlfqctl",
+  [SYS_setscheduler] "setscheduler",
+  [SYS_classstat] "classstat",
+  [SYS_setdeadline] "setdeadline",
+  [SYS_deadlinestat] "deadlinestat",
+  [SYS_nanosleep] "nanosleep",
+  [SYS_settickrate] "settickrate",
+  [SYS_setaffinity] "setaffinity",
+  [SYS_getaffinity] "getaffinity",
+  [SYS_schedhist] "schedhist",
+  [SYS_schedtrace] "schedtrace",
+  [SYS_clone] "clone",
+  [SYS_join] "join",
+  [SYS_futex_wait] "futex_wait",
+  [SYS_futex_wake] "futex_wake",
 };
 
 int syscallargs[] = {
@@ -201,6 +249,22 @@ int syscallargs[] = {
   [SYS_settickets] 1,
   [SYS_waitx] 3,
   [SYS_setpriority] 2,
+  [SYS_schedstat] 2,
+  [SYS_mlfqctl] 2,
+  [SYS_setscheduler] 2,
+  [SYS_classstat] 2,
+  [SYS_setdeadline] 4,
+  [SYS_deadlinestat] 2,
+  [SYS_nanosleep] 1,
+  [SYS_settickrate] 1,
+  [SYS_setaffinity] 2,
+  [SYS_getaffinity] 2,
+  [SYS_schedhist] 2,
+  [SYS_schedtrace] 3,
+  [SYS_clone] 3,
+  [SYS_join] 1,
+  [SYS_futex_wait] 2,
+  [SYS_futex_wake] 2,
 };
 
 
@@ -218,7 +282,7 @@ syscall(void)
     uint64 firstarg = argraw(0);
 
     p->trapframe->a0 = syscalls[num]();
-    if(p->mask & (1 << num)) {
+    if(num < 32 && (p->mask & (1U << num))) {
       //print the pid, syscall number, syscall name, arguments, and return value
       printf("%d: syscall %d %s(", p->pid, num, syscallnames[num]);
       for(int i = 0; i < syscallargs[num]; i++) {
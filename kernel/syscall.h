@@ -26,3 +26,19 @@
 #define SYS_settickets 25
 #define SYS_waitx 26
 #define SYS_setpriority 27
+#define SYS_schedstat 28
+#define SYS_mlfqctl 29
+#define SYS_setscheduler 30
+#define SYS_classstat 31
+#define SYS_setdeadline 32
+#define SYS_deadlinestat 33
+#define SYS_nanosleep 34
+#define SYS_settickrate 35
+#define SYS_setaffinity 36
+#define SYS_getaffinity 37
+#define SYS_schedhist 38
+#define SYS_schedtrace 39
+#define SYS_clone 40
+#define SYS_join 41
+#define SYS_futex_wait 42
+#define SYS_futex_wake 43
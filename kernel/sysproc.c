@@ -38,34 +38,31 @@ sys_wait(void)
 uint64
 sys_sbrk(void)
 {
-  uint64 addr;
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
-    return -1;
-  return addr;
+  return growproc(n);
 }
 
 uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n <= 0)
+    return 0;
+  return timer_sleep(r_time() + (uint64)n * tick_cycles);
+}
+
+// Sleep for nsec nanoseconds, to the resolution of mtime.
+uint64
+sys_nanosleep(void)
+{
+  uint64 nsec;
+
+  argaddr(0, &nsec);
+  return timer_sleep(r_time() + (nsec * (MTIME_HZ / 1000000) + 999) / 1000);
 }
 
 uint64
@@ -122,8 +119,7 @@ sys_settickets(void)
 {
   int tickets;
   argint(0, &tickets);
-  settickets(tickets);
-  return 0;
+  return settickets(tickets);
 }
 
 uint64
@@ -152,4 +148,165 @@ sys_setpriority(void)
   argint(1, &pid);
 
   return set_priority(priority, pid);
-}
\ No newline at end of file
+}
+
+uint64
+sys_schedstat(void)
+{
+  int cpu;
+  uint64 addr;
+  argint(0, &cpu);
+  argaddr(1, &addr);
+
+  return schedstat(cpu, addr);
+}
+
+uint64
+sys_mlfqctl(void)
+{
+  uint64 get, set;
+  argaddr(0, &get);
+  argaddr(1, &set);
+
+  return mlfqctl(get, set);
+}
+
+uint64
+sys_setscheduler(void)
+{
+  int pid, class;
+  argint(0, &pid);
+  argint(1, &class);
+
+  return setscheduler(pid, class);
+}
+
+uint64
+sys_classstat(void)
+{
+  int class;
+  uint64 addr;
+  argint(0, &class);
+  argaddr(1, &addr);
+
+  return classstat(class, addr);
+}
+
+uint64
+sys_setdeadline(void)
+{
+  int pid, runtime, deadline, period;
+  argint(0, &pid);
+  argint(1, &runtime);
+  argint(2, &deadline);
+  argint(3, &period);
+
+  return setdeadline(pid, runtime, deadline, period);
+}
+
+uint64
+sys_deadlinestat(void)
+{
+  int pid;
+  uint64 addr;
+  argint(0, &pid);
+  argaddr(1, &addr);
+
+  return deadlinestat(pid, addr);
+}
+
+uint64
+sys_setaffinity(void)
+{
+  int pid;
+  uint64 mask;
+  argint(0, &pid);
+  argaddr(1, &mask);
+
+  return setaffinity(pid, mask);
+}
+
+uint64
+sys_getaffinity(void)
+{
+  int pid;
+  uint64 addr;
+  argint(0, &pid);
+  argaddr(1, &addr);
+
+  return getaffinity(pid, addr);
+}
+
+uint64
+sys_schedhist(void)
+{
+  int pid;
+  uint64 addr;
+  argint(0, &pid);
+  argaddr(1, &addr);
+
+  return schedhist(pid, addr);
+}
+
+uint64
+sys_schedtrace(void)
+{
+  int on, n;
+  uint64 addr;
+  argint(0, &on);
+  argaddr(1, &addr);
+  argint(2, &n);
+
+  return schedtrace(on, addr, n);
+}
+
+uint64
+sys_settickrate(void)
+{
+  int hz;
+  argint(0, &hz);
+
+  return settickrate(hz);
+}
+
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_join(void)
+{
+  int tid;
+  argint(0, &tid);
+
+  return join(tid);
+}
+
+uint64
+sys_futex_wait(void)
+{
+  uint64 addr;
+  int val;
+  argaddr(0, &addr);
+  argint(1, &val);
+
+  return futex_wait(addr, val);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 addr;
+  int n;
+  argaddr(0, &addr);
+  argint(1, &n);
+
+  return futex_wake(addr, n);
+}
@@ -0,0 +1,245 @@
+// Timer wheel.
+//
+// Timers expire at an absolute mtime. They are kept in a
+// hierarchical wheel of TW_LEVELS levels of TW_SLOTS slots:
+// level 0 holds the timers due within TW_SLOTS units of
+// 2^TW_SHIFT mtime cycles, level 1 those due within
+// TW_SLOTS^2 units, and so on. Adding or cancelling a timer
+// is O(1). Each clock tick advances the wheel to the current
+// time; whenever level 0 wraps around, the next slot of
+// level 1 is cascaded down into level 0, and likewise up the
+// levels. So a timer is touched at most once per level
+// before it expires, and only expired timers are run.
+//
+// Hart 0 runs the wheel. Its comparator is programmed for
+// tw.next, the earliest expiry in level 0, or the next time
+// level 0 wraps and needs cascading into, so timers run when
+// they are due rather than at the next clock tick.
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "defs.h"
+
+#define TW_SHIFT  14            // a unit is 2^14 mtime cycles, 1.6ms in qemu
+#define TW_BITS   6
+#define TW_SLOTS  (1 << TW_BITS)
+#define TW_MASK   (TW_SLOTS - 1)
+#define TW_LEVELS 4
+
+struct {
+  struct spinlock lock;
+  uint64 clk;                   // the next unit to run
+  uint64 next;                  // mtime hart 0 must run the wheel at, or 0
+  uint64 cascaded;              // the last unit cascaded into
+  int n;                        // timers on the wheel
+  struct timer *slot[TW_LEVELS][TW_SLOTS];
+} tw;
+
+void
+twinit(void)
+{
+  initlock(&tw.lock, "timers");
+  tw.clk = r_time() >> TW_SHIFT;
+  tw.cascaded = -1;
+}
+
+// Put t in the slot that covers its expiry.
+// Caller must hold tw.lock.
+static void
+tw_insert(struct timer *t)
+{
+  uint64 e = t->expires >> TW_SHIFT;
+  uint64 d;
+  int level;
+
+  if(e < tw.clk)
+    e = tw.clk;
+  d = e - tw.clk;
+  for(level = 0; level < TW_LEVELS - 1; level++)
+    if(d < (1UL << (TW_BITS * (level + 1))))
+      break;
+  if(d >= (1UL << (TW_BITS * TW_LEVELS))){
+    // too far off: park it as late as the wheel reaches.
+    // It is cascaded back in again rather than run early.
+    e = tw.clk + (1UL << (TW_BITS * TW_LEVELS)) - 1;
+  }
+
+  t->slot = &tw.slot[level][(e >> (TW_BITS * level)) & TW_MASK];
+  t->prev = 0;
+  t->next = *t->slot;
+  if(t->next)
+    t->next->prev = t;
+  *t->slot = t;
+  t->pending = 1;
+}
+
+// Caller must hold tw.lock.
+static void
+tw_remove(struct timer *t)
+{
+  if(t->prev)
+    t->prev->next = t->next;
+  else
+    *t->slot = t->next;
+  if(t->next)
+    t->next->prev = t->prev;
+  t->next = t->prev = 0;
+  t->pending = 0;
+  tw.n--;
+}
+
+// Recompute tw.next. Caller must hold tw.lock.
+static void
+tw_update_next(void)
+{
+  struct timer *t;
+  uint64 next = 0, u;
+
+  for(u = tw.clk; tw.n > 0 && next == 0 && u < tw.clk + TW_SLOTS; u++){
+    if((u & TW_MASK) == 0 && u != tw.cascaded){
+      // wake to cascade the levels above down first.
+      next = u << TW_SHIFT;
+      break;
+    }
+    for(t = tw.slot[0][u & TW_MASK]; t; t = t->next)
+      if(next == 0 || t->expires < next)
+        next = t->expires;
+  }
+  tw.next = next;
+}
+
+// When hart 0 next has to run the wheel, or 0 if it is
+// empty. Read without the lock, it is only a hint.
+uint64
+timer_next(void)
+{
+  return tw.next;
+}
+
+// Call fn(arg) from the clock interrupt once mtime reaches
+// expires. fn runs with the wheel locked, so it may wake
+// processes but must not sleep or add or cancel timers.
+void
+timer_add(struct timer *t, uint64 expires, void (*fn)(void*), void *arg)
+{
+  acquire(&tw.lock);
+  if(t->pending)
+    panic("timer_add");
+  t->expires = expires;
+  t->fn = fn;
+  t->arg = arg;
+  // an empty wheel need not be advanced unit by unit.
+  if(tw.n++ == 0)
+    tw.clk = r_time() >> TW_SHIFT;
+  tw_insert(t);
+  if(tw.next == 0 || expires < tw.next){
+    tw.next = expires;
+    release(&tw.lock);
+    clockpoke();
+    return;
+  }
+  release(&tw.lock);
+}
+
+// Take t off the wheel before it expires. Returns 1 if it
+// was pending, 0 if it had already run or was never added.
+int
+timer_cancel(struct timer *t)
+{
+  int r = 0;
+
+  acquire(&tw.lock);
+  if(t->pending){
+    tw_remove(t);
+    r = 1;
+  }
+  release(&tw.lock);
+  return r;
+}
+
+// Put the timers of slot i of level back on the wheel,
+// which moves them down a level. Returns i.
+// Caller must hold tw.lock.
+static int
+tw_cascade(int level, int i)
+{
+  struct timer *t, *next;
+
+  t = tw.slot[level][i];
+  tw.slot[level][i] = 0;
+  for(; t; t = next){
+    next = t->next;
+    tw_insert(t);
+  }
+  return i;
+}
+
+// Advance the wheel to the current time and run the timers
+// that have expired. Called from clockintr().
+void
+timer_run(void)
+{
+  struct timer *t, *next;
+  uint64 now;
+  int i;
+
+  acquire(&tw.lock);
+  now = r_time();
+  while(tw.clk <= (now >> TW_SHIFT)){
+    i = tw.clk & TW_MASK;
+    // level 0 wrapped: bring the next slot of level 1
+    // down, and of level 2 if level 1 wrapped too...
+    if(i == 0 && tw.cascaded != tw.clk){
+      tw.cascaded = tw.clk;
+      for(int level = 1; level < TW_LEVELS; level++)
+        if(tw_cascade(level, (tw.clk >> (TW_BITS * level)) & TW_MASK) != 0)
+          break;
+    }
+    for(t = tw.slot[0][i]; t; t = next){
+      next = t->next;
+      if(t->expires <= now){
+        tw_remove(t);
+        t->fn(t->arg);
+      }
+    }
+    // the rest of this unit is still to come.
+    if(tw.slot[0][i])
+      break;
+    tw.clk++;
+  }
+  tw_update_next();
+  release(&tw.lock);
+}
+
+static void
+timer_wakeup(void *chan)
+{
+  wakeup(chan);
+}
+
+// Sleep until mtime reaches expires. Returns -1 if the
+// process is killed first.
+int
+timer_sleep(uint64 expires)
+{
+  struct timer t;
+  int r = 0;
+
+  t.pending = 0;
+  timer_add(&t, expires, timer_wakeup, &t);
+  acquire(&tw.lock);
+  while(t.pending){
+    if(killed(myproc())){
+      tw_remove(&t);
+      r = -1;
+      break;
+    }
+    sleep(&t, &tw.lock);
+  }
+  release(&tw.lock);
+  return r;
+}
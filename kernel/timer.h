@@ -0,0 +1,10 @@
+// Kernel timeout, see timer.c.
+struct timer {
+  uint64 expires;          // mtime at which fn is called
+  void (*fn)(void*);       // called from the clock interrupt
+  void *arg;
+  int pending;             // Is it on the wheel?
+  struct timer *next;      // Next timer in the same slot
+  struct timer *prev;      // Previous timer in the same slot
+  struct timer **slot;     // The wheel slot it is in
+};
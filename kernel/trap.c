@@ -8,9 +8,11 @@
 
 struct spinlock tickslock;
 uint ticks;
+uint64 tick_cycles = MTIME_HZ / TICK_HZ; // mtime cycles per tick, see settickrate()
+uint64 tick_last;          // mtime of the last tick counted in ticks
+int tick_cpu;              // the hart that counts ticks, or -1; hart 0 at boot
 
 extern char trampoline[], uservec[], userret[];
-struct que mlfqs[MLFQ_LEVELS];
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
@@ -22,6 +24,7 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  tick_last = r_time();
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -92,7 +95,6 @@ usertrap(void)
 
   // give up the CPU if this is a timer interrupt.
  if(which_dev == 2){
-    #ifdef RR
     if(p->alarm_flag == 1){
 
       p->current_ticks++;
@@ -109,28 +111,13 @@ usertrap(void)
 
 
     }
+  }
+  if((which_dev == 2 || which_dev == 3) && sched_tick(p))
     yield();
-    #endif
-    #ifdef MLFQ
-    if((p->cq_rticks) >= (1 << (p->curr_q)) ){
-      if(p->curr_q < 4){
-        p->curr_q++;
-        p->cq_rticks = 0;
-      }
-      yield();
-    }
-    for(int q = 0; q < p->curr_q; q++){
-      if(mlfqs[q].size > 0){
-        yield();
-      }
-    }
-    #endif
-    #ifdef LBS
-    yield();
-    #endif
 
-
-  }
+  // a better process was queued for this cpu.
+  if(resched_pending())
+    yield();
 
   usertrapret();
 }
@@ -178,7 +165,7 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64))trampoline_userret)(satp);
+  ((void (*)(uint64, uint64))trampoline_userret)(satp, p->tfva);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -202,35 +189,13 @@ kerneltrap()
     // printf("processname: %s\n", myproc()->name);
     panic("kerneltrap");
   }
-  #ifdef MLFQ
-  struct proc*p = myproc();
-  #endif
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
-  {
-    #ifdef MLFQ
-    if((p->cq_rticks) >= (1 << (p->curr_q)) ){
-      if(p->curr_q < 4){
-        p->curr_q++;
-
-      }
-      p->cq_rticks = 0;
-      yield();
-    }
-    for(int q = 0; q < p->curr_q; q++){
-      if(mlfqs[q].size > 0){
-        yield();
-      }
-    }
-    #endif
-    #ifdef RR
+  if((which_dev == 2 || which_dev == 3) && myproc() != 0 &&
+     myproc()->state == RUNNING && sched_tick(myproc()))
     yield();
-    #endif
-    #ifdef LBS
+  if(myproc() != 0 && myproc()->state == RUNNING && resched_pending())
     yield();
-    #endif
-  }
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
   w_sepc(sepc);
@@ -240,16 +205,154 @@ kerneltrap()
 void
 clockintr()
 {
+  uint now, n;
+
+  // count the ticks missed while every hart was idle too.
   acquire(&tickslock);
-  ticks++;
-  update_ticks();
-  wakeup(&ticks);
+  n = (r_time() - tick_last) / tick_cycles;
+  ticks += n;
+  tick_last += n * tick_cycles;
+  now = ticks;
   release(&tickslock);
+
+  if(n > 0 && now / BALANCETICKS != (now - n) / BALANCETICKS)
+    rebalance();
+}
+
+// Program this hart's CLINT comparator for its next event:
+// its next clock tick, the end of the running process's
+// slice, or on hart 0 the next timer on the wheel.
+// Interrupts must be disabled.
+void
+clockprogram(void)
+{
+  struct cpu *c = mycpu();
+  volatile uint64 *cmp = (uint64*)CLINT_MTIMECMP(cpuid());
+  uint64 next = -1, t;
+
+  // an idle hart with nothing queued needs no ticks.
+  if(!c->idle || c->rq.size > 0)
+    next = c->next_tick;
+  if(c->slice_end > r_time() && c->slice_end < next)
+    next = c->slice_end;
+  if(cpuid() == 0 && (t = timer_next()) != 0 && t < next)
+    next = t;
+  *cmp = next;
+}
+
+// A timer sooner than any other was added to the wheel:
+// make sure hart 0, which runs the wheel, is interrupted by
+// then. Only hart 0 writes its comparator, so another hart
+// sends it an IPI and it reprograms itself in clockevent().
+void
+clockpoke(void)
+{
+  push_off();
+  if(cpuid() == 0)
+    clockprogram();
+  else
+    ipi(0);
+  pop_off();
+}
+
+// This hart is going idle: hand counting ticks over to a
+// hart that is still running, and stop the clock tick.
+// Interrupts must be disabled.
+void
+clockidle(void)
+{
+  __sync_bool_compare_and_swap(&tick_cpu, cpuid(), -1);
+  clockprogram();
+}
+
+// Interrupt hart, to make it look at its run queue.
+void
+ipi(int hart)
+{
+  *(volatile uint32*)CLINT_MSIP(hart) = 1;
+}
+
+// Make hart flush its TLB, and wait until it has. It does
+// so at its next software interrupt, so the caller must not
+// hold a spinlock that hart might be waiting for.
+void
+tlbshootdown(int hart)
+{
+  struct cpu *c = &cpus[hart];
+  uint64 gen = __sync_add_and_fetch(&c->flush_req, 1);
+
+  ipi(hart);
+  while(*(volatile uint64*)&c->flush_done < gen)
+    ;
+  __sync_synchronize();
+}
+
+// Do the TLB flushes other harts asked of this one. A
+// request made after flush_req is read comes with an IPI of
+// its own, since timervec clears msip before this runs.
+static void
+tlbflush(void)
+{
+  struct cpu *c = mycpu();
+  uint64 gen = *(volatile uint64*)&c->flush_req;
+
+  if(c->flush_done == gen)
+    return;
+  sfence_vma();
+  __sync_synchronize();
+  c->flush_done = gen;
+}
+
+// Set the clock tick rate to hz ticks per second, and
+// return the previous rate; hz <= 0 only returns it. Each
+// hart switches at its next tick. Quanta, sleep() and
+// uptime() count ticks, so they scale with the rate.
+int
+settickrate(int hz)
+{
+  int old = MTIME_HZ / tick_cycles;
+
+  if(hz > TICK_HZ_MAX)
+    return -1;
+  if(hz > 0)
+    tick_cycles = MTIME_HZ / hz;
+  return old;
+}
+
+// This hart's comparator fired, or another hart sent an
+// IPI: run what is due. Returns 2 for a clock tick, 3 if the
+// running process's slice has run out, or 1.
+static int
+clockevent(void)
+{
+  struct cpu *c = mycpu();
+  uint64 now = r_time(), t;
+  int r = 1;
+
+  if(now >= c->next_tick){
+    c->next_tick += tick_cycles;
+    if(c->next_tick <= now)
+      c->next_tick = now + tick_cycles;
+    if(tick_cpu < 0)
+      __sync_bool_compare_and_swap(&tick_cpu, -1, cpuid());
+    if(tick_cpu == cpuid())
+      clockintr();
+    mlfq_age();
+    edf_replenish();
+    r = 2;
+  } else if(c->slice_end && now >= c->slice_end){
+    r = 3;
+  }
+  if(cpuid() == 0 && (t = timer_next()) != 0 && now >= t)
+    timer_run();
+  clockprogram();
+  return r;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
+// 3 if the running process's slice ran out,
 // 1 if other device,
 // 0 if not recognized.
 int
@@ -283,21 +386,36 @@ devintr()
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    tlbflush();
+    return clockevent();
   } else {
     return 0;
   }
 }
 
+static int cowcopy(pagetable_t pagetable, uint64 va);
+
+// Threads share the page table, so two of them may fault on
+// the same COW page at once; the thread group lock makes the
+// copy happen once.
 int cowfault(pagetable_t pagetable, uint64 va)
+{
+  struct proc *p = myproc();
+  int r;
+
+  if (p == 0 || p->pagetable != pagetable)
+    return cowcopy(pagetable, va);
+  acquire(&p->tg->lock);
+  r = cowcopy(pagetable, va);
+  release(&p->tg->lock);
+  return r;
+}
+
+static int cowcopy(pagetable_t pagetable, uint64 va)
 {
   if (va >= MAXVA)
     return -1;
@@ -0,0 +1,50 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+// Show the MLFQ tunables and per-level counters, or change
+// the tunables:
+//   mlfqctl
+//   mlfqctl aging <ticks>
+//   mlfqctl quantum <level> <ticks>
+
+void
+usage(void)
+{
+  fprintf(2, "usage: mlfqctl [aging ticks | quantum level ticks]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct mlfqstat st;
+  int q;
+
+  if(mlfqctl(&st, 0) < 0){
+    fprintf(2, "mlfqctl: failed\n");
+    exit(1);
+  }
+  if(argc == 3 && strcmp(argv[1], "aging") == 0){
+    st.aging = atoi(argv[2]);
+  } else if(argc == 4 && strcmp(argv[1], "quantum") == 0){
+    q = atoi(argv[2]);
+    if(q < 0 || q >= MLFQ_LEVELS)
+      usage();
+    st.quantum[q] = atoi(argv[3]);
+  } else if(argc != 1){
+    usage();
+  }
+  if(argc > 1 && mlfqctl(0, &st) < 0){
+    fprintf(2, "mlfqctl: bad value\n");
+    exit(1);
+  }
+
+  printf("aging %d\n", st.aging);
+  printf("level\tquantum\tpromote\tdemote\n");
+  for(q = 0; q < MLFQ_LEVELS; q++)
+    printf("%d\t%d\t%d\t%d\n", q, st.quantum[q], (int)st.promote[q], (int)st.demote[q]);
+  exit(0);
+}
@@ -0,0 +1,105 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+// Run a fixed amount of CPU-bound work split over NWORK
+// processes and report how long it took. Running it with
+// CPUS=1 and with CPUS=8 gives the scheduler's speedup.
+//   scalebench [nwork]       workers are forked processes
+//   scalebench -t [nwork]    workers are threads of one process
+
+#define NWORK 16
+#define WORK  200000000
+
+int nwork = NWORK;
+int done[NTHREAD];
+
+void
+worker(void *arg)
+{
+  for(volatile int i = 0; i < WORK / nwork; i++)
+    ;
+  // threads share memory: main sees this.
+  done[(uint64)arg] = 1;
+}
+
+// Sum the statistics of every cpu that is scheduling.
+int
+total(struct schedstat *sum)
+{
+  struct schedstat st;
+  int ncpu = 0;
+
+  memset(sum, 0, sizeof(*sum));
+  for(int i = 0; i < NCPU; i++){
+    if(schedstat(i, &st) < 0 || !st.started)
+      continue;
+    ncpu++;
+    sum->nswitch += st.nswitch;
+    sum->nsteal += st.nsteal;
+    sum->nmigrate += st.nmigrate;
+    sum->idletime += st.idletime;
+  }
+  return ncpu;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct schedstat before, after;
+  int threads = 0;
+  int n, ndone, ncpu, start, elapsed;
+
+  if(argc > 1 && strcmp(argv[1], "-t") == 0){
+    threads = 1;
+    argc--;
+    argv++;
+  }
+  if(argc > 1)
+    nwork = atoi(argv[1]);
+  if(nwork < 1)
+    nwork = 1;
+  // the main thread holds one of the trapframe slots.
+  if(threads && nwork > NTHREAD - 1)
+    nwork = NTHREAD - 1;
+
+  ncpu = total(&before);
+  start = uptime();
+  for(n = 0; n < nwork; n++){
+    if(threads){
+      if(thread_create(worker, (void*)(uint64)n) < 0)
+        break;
+      continue;
+    }
+    int pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0){
+      worker(0);
+      exit(0);
+    }
+  }
+  for(; n > 0; n--){
+    if(threads)
+      thread_join(0);
+    else
+      wait(0);
+  }
+  elapsed = uptime() - start;
+  total(&after);
+
+  for(ndone = n = 0; n < NTHREAD; n++)
+    ndone += done[n];
+  printf("scalebench: %d %s on %d cpus: %d ticks\n", nwork,
+         threads ? "threads" : "workers", ncpu, elapsed);
+  if(threads && ndone != nwork)
+    printf("scalebench: only %d of %d threads finished\n", ndone, nwork);
+  printf("switches %d steals %d migrations %d idle %d ms\n",
+         (int)(after.nswitch - before.nswitch),
+         (int)(after.nsteal - before.nsteal),
+         (int)(after.nmigrate - before.nmigrate),
+         (int)((after.idletime - before.idletime) / (MTIME_HZ / 1000)));
+  exit(0);
+}
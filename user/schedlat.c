@@ -0,0 +1,104 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+// Print p50, p99 and the longest of the scheduling latencies
+// the kernel keeps in log2 histograms, in microseconds: the
+// wait from RUNNABLE to RUNNING, the length of each run and
+// of each sleep.
+//   schedlat            every cpu, class and process
+//   schedlat pid...     those processes
+
+#define US (MTIME_HZ / 1000000)
+
+// The time below which pct percent of histogram k's counts
+// fall, from the top of their bucket, or its longest time
+// if that is shorter.
+uint64
+percentile(struct schedhist *h, int k, int pct)
+{
+  uint64 n = 0, sum = 0, want, top;
+  int b;
+
+  for(b = 0; b < NHIST; b++)
+    n += h->count[k][b];
+  if(n == 0)
+    return 0;
+  want = (n * pct + 99) / 100;
+  for(b = 0; b < NHIST - 1; b++){
+    sum += h->count[k][b];
+    if(sum >= want)
+      break;
+  }
+  top = 2UL << b;
+  return top < h->max[k] ? top : h->max[k];
+}
+
+void
+show(char *what, struct schedhist *h)
+{
+  printf("%s", what);
+  for(int k = 0; k < NHISTS; k++)
+    printf("\t%d/%d/%d", (int)(percentile(h, k, 50) / US),
+           (int)(percentile(h, k, 99) / US), (int)(h->max[k] / US));
+  printf("\n");
+}
+
+// Add histogram b into a.
+void
+merge(struct schedhist *a, struct schedhist *b)
+{
+  for(int k = 0; k < NHISTS; k++){
+    for(int i = 0; i < NHIST; i++)
+      a->count[k][i] += b->count[k][i];
+    if(b->max[k] > a->max[k])
+      a->max[k] = b->max[k];
+  }
+}
+
+struct schedhist h, class[NSCHED];
+
+int
+main(int argc, char *argv[])
+{
+  struct schedstat st;
+  struct classstat cst;
+  char what[32];
+  int pid;
+
+  printf("\twait\tslice\tsleep (us p50/p99/max)\n");
+  if(argc > 1){
+    for(int i = 1; i < argc; i++){
+      pid = atoi(argv[i]);
+      if(schedhist(pid, &h) < 0){
+        fprintf(2, "schedlat: no pid %d\n", pid);
+        continue;
+      }
+      show(argv[i], &h);
+    }
+    exit(0);
+  }
+
+  for(int i = 0; i < NCPU; i++){
+    if(schedstat(i, &st) < 0 || !st.started)
+      continue;
+    strcpy(what, "cpu ");
+    what[4] = '0' + i;
+    what[5] = 0;
+    show(what, &st.hist);
+  }
+  for(pid = 1; pid <= getpid(); pid++){
+    if(schedhist(pid, &h) < 0)
+      continue;
+    if(h.sched >= 0 && h.sched < NSCHED)
+      merge(&class[h.sched], &h);
+    printf("%d ", pid);
+    show(h.name, &h);
+  }
+  for(int id = 0; id < NSCHED; id++)
+    if(classstat(id, &cst) == 0 && cst.nproc > 0)
+      show(cst.name, &class[id]);
+  exit(0);
+}
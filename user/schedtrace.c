@@ -0,0 +1,80 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+// Turn the scheduler event trace on or off, or print what it
+// has recorded as CSV, for plot.ipynb:
+//   schedtrace on | off
+//   schedtrace                 print the events recorded so far
+//   schedtrace cmd args...     trace cmd until it exits
+// Times are in microseconds of mtime.
+
+#define NEV 64
+
+char *names[] = {
+[SEV_ENQUEUE] "enqueue",
+[SEV_DEQUEUE] "dequeue",
+[SEV_SWITCH]  "switch",
+[SEV_LEVEL]   "level",
+[SEV_AGE]     "age",
+[SEV_LOST]    "lost",
+};
+
+struct schedev buf[NEV];
+
+// Print the n events in buf.
+void
+print(int n)
+{
+  for(int i = 0; i < n; i++){
+    struct schedev *e = &buf[i];
+    printf("%l,%d,%s,%d,%d,%d\n", e->time / (MTIME_HZ / 1000000), e->cpu,
+           e->type <= SEV_LOST && names[e->type] ? names[e->type] : "?",
+           e->pid, e->sched, e->level);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n;
+
+  if(argc == 2 && strcmp(argv[1], "on") == 0){
+    schedtrace(1, buf, 0);
+    exit(0);
+  }
+  if(argc == 2 && strcmp(argv[1], "off") == 0){
+    schedtrace(0, buf, 0);
+    exit(0);
+  }
+
+  printf("time,cpu,event,pid,class,level\n");
+  if(argc == 1){
+    while((n = schedtrace(-1, buf, NEV)) > 0)
+      print(n);
+    exit(0);
+  }
+
+  schedtrace(1, buf, 0);
+  if(fork() == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "schedtrace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  // empty the rings every tick so that they do not
+  // overflow, until cmd has exited and the trace is off.
+  if(fork() == 0){
+    while((n = schedtrace(-1, buf, NEV)) >= 0){
+      print(n);
+      if(n == 0)
+        sleep(1);
+    }
+    exit(0);
+  }
+  wait(0);
+  schedtrace(0, buf, 0);
+  wait(0);
+  exit(0);
+}
@@ -1,5 +1,7 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
 #include "user/user.h"
 #include "kernel/fcntl.h"
 
@@ -7,7 +9,29 @@
 #define NFORK 5
 #define IO 5
 
-int main() {
+#define NSHARE 3    // CPU-bound processes in the share test
+#define NWINDOW 4
+
+#define NCPUBOUND 4 // processes in the fairness test
+#define NIOBOUND 2
+#define FAIRTIME 100
+
+#define NEDF 3      // periodic processes in the deadline test
+#define EDFJOBS 20
+
+#define NHOG 8      // CPU-bound processes in the wakeup test
+#define NPING 200
+
+#define NLOCKER 4   // threads in the futex test
+#define NINCR 20000
+
+struct mutex mu;
+struct cond cv;
+int counter, turn;
+
+void
+benchmark(void)
+{
   int n, pid;
   int wtime, rtime;
   int twtime=0, trtime=0;
@@ -43,5 +67,338 @@ int main() {
       }
   }
   printf("Average rtime %d,  wtime %d\n", trtime / NFORK, twtime / NFORK);
+}
+
+// Proportional share: run NSHARE CPU-bound processes holding
+// 1, 2, ... NSHARE tickets for a window, then compare the
+// ticks each one got with its ticket share. Stride scheduling
+// keeps the error within about one quantum for every window;
+// lottery scheduling is only right on average. Run on one CPU.
+void
+share(void)
+{
+  static int windows[NWINDOW] = { 10, 20, 50, 100 };
+  int pids[NSHARE], got[NSHARE];
+  int w, n, pid, wtime, rtime;
+
+  for(w = 0; w < NWINDOW; w++){
+    for(n = 0; n < NSHARE; n++){
+      pid = fork();
+      if(pid < 0){
+        printf("schedulertest: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        settickets(n + 1);
+        for(;;)
+          ;
+      }
+      pids[n] = pid;
+    }
+    sleep(windows[w]);
+    for(n = 0; n < NSHARE; n++)
+      kill(pids[n]);
+
+    int total = 0, totaltickets = 0;
+    for(n = 0; n < NSHARE; n++){
+      got[n] = 0;
+      totaltickets += n + 1;
+    }
+    for(n = 0; n < NSHARE; n++){
+      if((pid = waitx(0, &wtime, &rtime)) < 0)
+        continue;
+      for(int i = 0; i < NSHARE; i++)
+        if(pids[i] == pid)
+          got[i] = rtime;
+      total += rtime;
+    }
+
+    // errors in hundredths of a tick.
+    int maxerr = 0;
+    for(n = 0; n < NSHARE; n++){
+      int expect = total * 100 * (n + 1) / totaltickets;
+      int err = got[n] * 100 - expect;
+      if(err < 0)
+        err = -err;
+      if(err > maxerr)
+        maxerr = err;
+      printf("window %d: tickets %d ran %d expected %d.%d\n",
+             windows[w], n + 1, got[n], expect / 100, expect % 100 / 10);
+    }
+    printf("window %d: max allocation error %d.%d ticks\n",
+           windows[w], maxerr / 100, maxerr % 100 / 10);
+  }
+}
+
+// Fairness: run NCPUBOUND CPU-bound and NIOBOUND I/O-bound
+// processes at the same priority for FAIRTIME ticks and print
+// Jain's index over the CPU-bound run times, (sum x)^2 / (n
+// sum x^2), in thousandths: 1000 means a perfectly even split.
+// The I/O-bound ones should still see short waits.
+void
+fair(void)
+{
+  int pids[NCPUBOUND + NIOBOUND], rt[NCPUBOUND] = { 0 };
+  int n, pid, wtime, rtime;
+  int iortime = 0, iowtime = 0;
+
+  for(n = 0; n < NCPUBOUND + NIOBOUND; n++){
+    pid = fork();
+    if(pid < 0){
+      printf("schedulertest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      if(n < NCPUBOUND)
+        for(;;)
+          ;
+      for(;;){
+        for(volatile int i = 0; i < 1000000; i++)
+          ;
+        sleep(1);
+      }
+    }
+    pids[n] = pid;
+  }
+  sleep(FAIRTIME);
+  for(n = 0; n < NCPUBOUND + NIOBOUND; n++)
+    kill(pids[n]);
+
+  for(n = 0; n < NCPUBOUND + NIOBOUND; n++){
+    if((pid = waitx(0, &wtime, &rtime)) < 0)
+      continue;
+    for(int i = 0; i < NCPUBOUND + NIOBOUND; i++){
+      if(pids[i] != pid)
+        continue;
+      if(i < NCPUBOUND){
+        rt[i] = rtime;
+      } else {
+        iortime += rtime;
+        iowtime += wtime;
+      }
+    }
+  }
+
+  uint64 sum = 0, sq = 0;
+  for(n = 0; n < NCPUBOUND; n++){
+    printf("cpu-bound %d: rtime %d\n", n, rt[n]);
+    sum += rt[n];
+    sq += (uint64)rt[n] * rt[n];
+  }
+  int index = sq ? sum * sum * 1000 / (NCPUBOUND * sq) : 0;
+  printf("fairness index %d.%d%d%d\n", index / 1000, index / 100 % 10,
+         index / 10 % 10, index % 10);
+  printf("io-bound: average rtime %d, wtime %d\n", iortime / NIOBOUND, iowtime / NIOBOUND);
+}
+
+// Deadlines: admit NEDF periodic processes, 90% of cpu 0
+// between them, alongside CPU-bound ones in the default
+// class. Each job computes for all but a tick of its
+// runtime, then sleeps until its next period. One more
+// process pinned to cpu 0 asking for 30%, which an empty
+// cpu would admit, must be refused. Each periodic process
+// reports its jobs and deadline misses.
+void
+edf(void)
+{
+  // runtime, deadline and period in ticks.
+  static int param[NEDF][3] = { { 2, 5, 5 }, { 3, 10, 10 }, { 2, 8, 10 } };
+  int pids[NEDF + NCPUBOUND], pid, n;
+  struct dlstat st;
+
+  for(n = 0; n < NEDF + NCPUBOUND; n++){
+    pid = fork();
+    if(pid < 0){
+      printf("schedulertest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      if(n >= NEDF)
+        for(;;)
+          ;
+      // wait to be admitted.
+      while(deadlinestat(getpid(), &st) < 0 || st.runtime == 0)
+        sleep(1);
+      int next = uptime();
+      for(int j = 0; j < EDFJOBS; j++){
+        int start = uptime();
+        while(uptime() - start < param[n][0] - 1)
+          ;
+        next += param[n][2];
+        if(next > uptime())
+          sleep(next - uptime());
+      }
+      deadlinestat(getpid(), &st);
+      printf("edf %d/%d/%d on cpu %d: %d jobs, %d missed, %d throttled\n",
+             st.runtime, st.deadline, st.period, st.cpu,
+             (int)st.njobs, (int)st.nmiss, (int)st.nthrottle);
+      exit(0);
+    }
+    pids[n] = pid;
+    if(n < NEDF && setaffinity(pid, 1) < 0)
+      printf("schedulertest: setaffinity failed\n");
+    if(n < NEDF && setdeadline(pid, param[n][0], param[n][1], param[n][2]) < 0)
+      printf("schedulertest: edf %d/%d/%d refused\n", param[n][0], param[n][1], param[n][2]);
+  }
+
+  // cpu 0 has only 5% left.
+  setaffinity(pids[NEDF], 1);
+  if(setdeadline(pids[NEDF], 3, 10, 10) == 0)
+    printf("schedulertest: edf 3/10/10 admitted on cpu 0, already 90%% full\n");
+  else
+    printf("edf 3/10/10 refused on cpu 0\n");
+
+  for(n = 0; n < NEDF; n++)
+    wait(0);
+  for(n = NEDF; n < NEDF + NCPUBOUND; n++)
+    kill(pids[n]);
+  for(n = NEDF; n < NEDF + NCPUBOUND; n++)
+    wait(0);
+}
+
+// Sum the wakeup counters of every cpu. max is the longest
+// wait since the last call.
+void
+wakeups(uint64 *n, uint64 *lat, uint64 *max)
+{
+  struct schedstat st;
+
+  *n = *lat = *max = 0;
+  for(int i = 0; i < NCPU; i++){
+    if(schedstat(i, &st) < 0)
+      continue;
+    *n += st.nwakeup;
+    *lat += st.wakelat;
+    if(st.wakelatmax > *max)
+      *max = st.wakelatmax;
+  }
+}
+
+// Wakeup latency: bounce a byte between two processes over
+// pipes NPING times while NHOG CPU-bound processes keep
+// every cpu busy. The two have the best priority, so each
+// wakeup should preempt a hog at once rather than at the
+// next tick. Prints the round trip and how long processes
+// woken during the test waited to run, in microseconds.
+void
+pingpong(void)
+{
+  int pids[NHOG], ping[2], pong[2], n, pid, start;
+  uint64 n0, lat0, n1, lat1, max;
+  char c = 0;
+
+  for(n = 0; n < NHOG; n++){
+    if((pid = fork()) < 0){
+      printf("schedulertest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      for(;;)
+        ;
+    pids[n] = pid;
+  }
+  pipe(ping);
+  pipe(pong);
+  setpriority(0, getpid());
+  if((pid = fork()) == 0){
+    for(n = 0; n < NPING; n++){
+      read(ping[0], &c, 1);
+      write(pong[1], &c, 1);
+    }
+    exit(0);
+  }
+  setpriority(0, pid);
+
+  wakeups(&n0, &lat0, &max);
+  start = uptime();
+  for(n = 0; n < NPING; n++){
+    write(ping[1], &c, 1);
+    read(pong[0], &c, 1);
+  }
+  start = uptime() - start;
+  wakeups(&n1, &lat1, &max);
+  wait(0);
+  for(n = 0; n < NHOG; n++)
+    kill(pids[n]);
+  for(n = 0; n < NHOG; n++)
+    wait(0);
+
+  printf("%d round trips in %d ticks\n", NPING, start);
+  if(n1 > n0)
+    printf("wakeup to run during the test: average %d us, longest %d us\n",
+           (int)((lat1 - lat0) / (n1 - n0) / (MTIME_HZ / 1000000)),
+           (int)(max / (MTIME_HZ / 1000000)));
+}
+
+void
+locker(void *arg)
+{
+  for(int i = 0; i < NINCR; i++){
+    mutex_lock(&mu);
+    counter++;
+    mutex_unlock(&mu);
+  }
+}
+
+void
+ponger(void *arg)
+{
+  mutex_lock(&mu);
+  for(int n = 0; n < NPING; n++){
+    while(turn != 1)
+      cond_wait(&cv, &mu);
+    turn = 0;
+    cond_signal(&cv);
+  }
+  mutex_unlock(&mu);
+}
+
+// Threads contending for a futex mutex, then passing a
+// turn back and forth through a condition variable.
+void
+futextest(void)
+{
+  int n, start;
+
+  start = uptime();
+  for(n = 0; n < NLOCKER; n++)
+    if(thread_create(locker, 0) < 0)
+      break;
+  for(; n > 0; n--)
+    thread_join(0);
+  printf("%d threads: counter %d of %d in %d ticks\n", NLOCKER, counter,
+         NLOCKER * NINCR, uptime() - start);
+
+  if(thread_create(ponger, 0) < 0){
+    printf("schedulertest: thread_create failed\n");
+    exit(1);
+  }
+  start = uptime();
+  mutex_lock(&mu);
+  for(n = 0; n < NPING; n++){
+    turn = 1;
+    cond_signal(&cv);
+    while(turn != 0)
+      cond_wait(&cv, &mu);
+  }
+  mutex_unlock(&mu);
+  start = uptime() - start;
+  thread_join(0);
+  printf("%d condvar round trips in %d ticks\n", NPING, start);
+}
+
+int main(int argc, char *argv[]) {
+  if(argc > 1 && strcmp(argv[1], "share") == 0)
+    share();
+  else if(argc > 1 && strcmp(argv[1], "fair") == 0)
+    fair();
+  else if(argc > 1 && strcmp(argv[1], "edf") == 0)
+    edf();
+  else if(argc > 1 && strcmp(argv[1], "pingpong") == 0)
+    pingpong();
+  else if(argc > 1 && strcmp(argv[1], "futex") == 0)
+    futextest();
+  else
+    benchmark();
   exit(0);
 }
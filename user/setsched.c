@@ -0,0 +1,54 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+// Change scheduling classes at run time, so that policies
+// can be compared on the same workload in one boot:
+//   setsched                     show the classes and their statistics
+//   setsched class               move every process to class
+//   setsched class cmd args...   run cmd in class
+
+int
+lookup(char *name)
+{
+  struct classstat st;
+
+  for(int id = 0; id < NSCHED; id++)
+    if(classstat(id, &st) == 0 && strcmp(st.name, name) == 0)
+      return id;
+  return -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct classstat st;
+  int id, def;
+
+  if(argc == 1){
+    def = setscheduler(0, -1);
+    printf("class\tnproc\tswitch\tpreempt\truntime(ms)\n");
+    for(id = 0; id < NSCHED; id++){
+      if(classstat(id, &st) < 0)
+        continue;
+      printf("%s%s\t%d\t%d\t%d\t%d\n", st.name, id == def ? "*" : "", st.nproc,
+             (int)st.nswitch, (int)st.npreempt, (int)(st.runtime / (MTIME_HZ / 1000)));
+    }
+    exit(0);
+  }
+
+  if((id = lookup(argv[1])) < 0){
+    fprintf(2, "setsched: unknown class %s\n", argv[1]);
+    exit(1);
+  }
+  if(argc == 2){
+    setscheduler(0, id);
+    exit(0);
+  }
+  setscheduler(getpid(), id);
+  exec(argv[2], argv + 2);
+  fprintf(2, "setsched: exec %s failed\n", argv[2]);
+  exit(1);
+}
@@ -0,0 +1,71 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Show or set which cpus a process may run on. Masks are in
+// hex, bit i for cpu i:
+//   taskset -p pid          show pid's mask
+//   taskset -p pid mask     set it
+//   taskset mask cmd args... run cmd on the cpus in mask
+
+void
+usage(void)
+{
+  fprintf(2, "usage: taskset -p pid [mask] | taskset mask cmd args...\n");
+  exit(1);
+}
+
+uint64
+hex(char *s)
+{
+  uint64 n = 0;
+
+  if(s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+    s += 2;
+  if(*s == 0)
+    usage();
+  for(; *s; s++){
+    if(*s >= '0' && *s <= '9')
+      n = n * 16 + *s - '0';
+    else if(*s >= 'a' && *s <= 'f')
+      n = n * 16 + *s - 'a' + 10;
+    else if(*s >= 'A' && *s <= 'F')
+      n = n * 16 + *s - 'A' + 10;
+    else
+      usage();
+  }
+  return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 mask;
+  int pid;
+
+  if(argc < 3)
+    usage();
+  if(strcmp(argv[1], "-p") == 0){
+    if(argc > 4)
+      usage();
+    pid = atoi(argv[2]);
+    if(argc == 4 && setaffinity(pid, hex(argv[3])) < 0){
+      fprintf(2, "taskset: cannot set pid %d to mask %s\n", pid, argv[3]);
+      exit(1);
+    }
+    if(getaffinity(pid, &mask) < 0){
+      fprintf(2, "taskset: no pid %d\n", pid);
+      exit(1);
+    }
+    printf("pid %d mask %x\n", pid, (int)mask);
+    exit(0);
+  }
+
+  if(setaffinity(getpid(), hex(argv[1])) < 0){
+    fprintf(2, "taskset: bad mask %s\n", argv[1]);
+    exit(1);
+  }
+  exec(argv[2], argv + 2);
+  fprintf(2, "taskset: exec %s failed\n", argv[2]);
+  exit(1);
+}
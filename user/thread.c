@@ -0,0 +1,128 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+//
+// threads on clone(). thread_create() and thread_join()
+// keep the stacks in one table, so call them from one
+// thread.
+//
+#define TSTACK 16384
+
+struct tstart {
+  void (*fn)(void*);
+  void *arg;
+};
+
+static struct {
+  int tid;
+  char *stack;
+} tstacks[NTHREAD];
+
+static void
+thread_start(void *a)
+{
+  struct tstart *t = a;
+
+  t->fn(t->arg);
+  exit(0);
+}
+
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  struct tstart *t;
+  char *stack;
+  int i, tid;
+
+  for(i = 0; i < NTHREAD && tstacks[i].stack; i++)
+    ;
+  if(i == NTHREAD || (stack = malloc(TSTACK)) == 0)
+    return -1;
+  // fn and arg sit at the top of the new stack.
+  t = (struct tstart*)(stack + TSTACK) - 1;
+  t->fn = fn;
+  t->arg = arg;
+  if((tid = clone(thread_start, t, t)) < 0){
+    free(stack);
+    return -1;
+  }
+  tstacks[i].tid = tid;
+  tstacks[i].stack = stack;
+  return tid;
+}
+
+int
+thread_join(int tid)
+{
+  int i;
+
+  if((tid = join(tid)) < 0)
+    return -1;
+  for(i = 0; i < NTHREAD; i++){
+    if(tstacks[i].stack && tstacks[i].tid == tid){
+      free(tstacks[i].stack);
+      tstacks[i].stack = 0;
+    }
+  }
+  return tid;
+}
+
+//
+// Mutex on futexes, after Drepper's "Futexes Are Tricky".
+// state is 0 when unlocked, 1 when locked, and 2 when
+// locked with threads (maybe) waiting, so an uncontended
+// lock and unlock make no system call.
+//
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = __sync_lock_test_and_set(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    __sync_lock_release(&m->state);
+    futex_wake(&m->state, 1);
+  }
+}
+
+//
+// Condition variable: a sequence number that signals bump.
+// A waiter sleeps only if no signal came after it read seq,
+// and must check its condition again when it returns.
+//
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  mutex_lock(m);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, NPROC);
+}
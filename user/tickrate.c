@@ -0,0 +1,28 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Show or set the clock tick rate, in ticks per second:
+//   tickrate
+//   tickrate hz
+
+int
+main(int argc, char *argv[])
+{
+  int hz;
+
+  if(argc > 2 || (argc == 2 && atoi(argv[1]) <= 0)){
+    fprintf(2, "usage: tickrate [hz]\n");
+    exit(1);
+  }
+  hz = settickrate(argc == 2 ? atoi(argv[1]) : 0);
+  if(hz < 0){
+    fprintf(2, "tickrate: bad rate %s\n", argv[1]);
+    exit(1);
+  }
+  if(argc == 2)
+    printf("tickrate %d -> %d\n", hz, atoi(argv[1]));
+  else
+    printf("tickrate %d\n", hz);
+  exit(0);
+}
@@ -1,4 +1,19 @@
 struct stat;
+struct schedstat;
+struct schedev;
+struct schedhist;
+struct classstat;
+struct mlfqstat;
+struct dlstat;
+struct uchan;
+
+struct mutex {
+  int state;
+};
+
+struct cond {
+  int seq;
+};
 
 // system calls
 int fork(void);
@@ -28,6 +43,22 @@ int sigreturn(void);
 int settickets(int);
 int waitx(int*, int* /*wtime*/, int* /*rtime*/);
 int setpriority(int, int);
+int schedstat(int, struct schedstat*);
+int mlfqctl(struct mlfqstat*, struct mlfqstat*);
+int setscheduler(int, int);
+int classstat(int, struct classstat*);
+int setdeadline(int, int, int, int);
+int deadlinestat(int, struct dlstat*);
+int nanosleep(uint64);
+int settickrate(int);
+int setaffinity(int, uint64);
+int getaffinity(int, uint64*);
+int schedhist(int, struct schedhist*);
+int schedtrace(int, struct schedev*, int);
+int clone(void (*)(void*), void*, void*);
+int join(int);
+int futex_wait(int*, int);
+int futex_wake(int*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -45,3 +76,22 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+
+// thread.c
+int thread_create(void (*)(void*), void*);
+int thread_join(int);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
+
+// uthread.c, linked only into programs that use it
+int uthread_create(void (*)(void*), void*);
+void uthread_yield(void);
+void uthread_exit(void);
+int uthread_run(void);
+struct uchan* uchan_new(int);
+void uchan_free(struct uchan*);
+void uchan_send(struct uchan*, uint64);
+uint64 uchan_recv(struct uchan*);
@@ -42,3 +42,19 @@ entry("sigreturn");
 entry("settickets");
 entry("waitx");
 entry("setpriority");
+entry("schedstat");
+entry("mlfqctl");
+entry("setscheduler");
+entry("classstat");
+entry("setdeadline");
+entry("deadlinestat");
+entry("nanosleep");
+entry("settickrate");
+entry("setaffinity");
+entry("getaffinity");
+entry("schedhist");
+entry("schedtrace");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
@@ -0,0 +1,228 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+//
+// Green threads: cooperative user-level threads, all in
+// one process, switched by uthread_switch() without the
+// kernel. The process's main() creates the first threads
+// and calls uthread_run(), which plays the part of the
+// kernel's scheduler(): it switches to the thread at the
+// head of the run queue, and gets control back when that
+// thread yields, blocks on a channel or exits.
+//
+
+#define USTACK 8192
+
+// Saved registers for uthread_switch(), laid out like the
+// kernel's struct context.
+struct uctx {
+  uint64 ra;
+  uint64 sp;
+  uint64 s[12];
+};
+
+enum ustate { U_RUNNABLE, U_BLOCKED, U_DONE };
+
+struct uthread {
+  struct uctx ctx;
+  enum ustate state;
+  void (*fn)(void*);
+  void *arg;
+  char *stack;
+  struct uthread *next;    // on the run queue or a channel's
+};
+
+struct uqueue {
+  struct uthread *head;
+  struct uthread *tail;
+};
+
+struct uchan {
+  uint64 *buf;
+  int cap;
+  int head;                // oldest message
+  int n;                   // messages in buf
+  struct uqueue senders;   // blocked while buf is full
+  struct uqueue receivers; // blocked while buf is empty
+};
+
+void uthread_switch(struct uctx*, struct uctx*);
+
+static struct uctx sched;         // uthread_run()'s context
+static struct uthread *current;
+static struct uqueue runq;
+static int nblocked;
+
+static void
+enqueue(struct uqueue *q, struct uthread *t)
+{
+  t->next = 0;
+  if(q->tail)
+    q->tail->next = t;
+  else
+    q->head = t;
+  q->tail = t;
+}
+
+static struct uthread*
+dequeue(struct uqueue *q)
+{
+  struct uthread *t;
+
+  if((t = q->head) != 0){
+    q->head = t->next;
+    if(q->head == 0)
+      q->tail = 0;
+  }
+  return t;
+}
+
+// Give the cpu back to uthread_run().
+static void
+uthread_sched(void)
+{
+  uthread_switch(&current->ctx, &sched);
+}
+
+// A new thread's first switch returns here.
+static void
+uthread_start(void)
+{
+  current->fn(current->arg);
+  uthread_exit();
+}
+
+int
+uthread_create(void (*fn)(void*), void *arg)
+{
+  struct uthread *t;
+
+  if((t = malloc(sizeof(*t))) == 0)
+    return -1;
+  if((t->stack = malloc(USTACK)) == 0){
+    free(t);
+    return -1;
+  }
+  memset(&t->ctx, 0, sizeof(t->ctx));
+  t->ctx.ra = (uint64)uthread_start;
+  t->ctx.sp = (uint64)(t->stack + USTACK);
+  t->fn = fn;
+  t->arg = arg;
+  t->state = U_RUNNABLE;
+  enqueue(&runq, t);
+  return 0;
+}
+
+void
+uthread_yield(void)
+{
+  enqueue(&runq, current);
+  uthread_sched();
+}
+
+void
+uthread_exit(void)
+{
+  current->state = U_DONE;
+  uthread_sched();
+}
+
+// Run threads until none is runnable. Return how many are
+// left blocked on channels, deadlocked.
+int
+uthread_run(void)
+{
+  struct uthread *t;
+
+  while((t = dequeue(&runq)) != 0){
+    current = t;
+    uthread_switch(&sched, &t->ctx);
+    current = 0;
+    // t's stack is free to go now that we are off it.
+    if(t->state == U_DONE){
+      free(t->stack);
+      free(t);
+    }
+  }
+  return nblocked;
+}
+
+// Sleep on q until wake() moves us back to the run queue.
+static void
+block(struct uqueue *q)
+{
+  current->state = U_BLOCKED;
+  nblocked++;
+  enqueue(q, current);
+  uthread_sched();
+}
+
+static void
+wake(struct uqueue *q)
+{
+  struct uthread *t;
+
+  if((t = dequeue(q)) != 0){
+    t->state = U_RUNNABLE;
+    nblocked--;
+    enqueue(&runq, t);
+  }
+}
+
+//
+// Channels: FIFO queues of cap messages between threads.
+// uchan_send() blocks while the channel is full, and
+// uchan_recv() while it is empty. Only threads may use
+// them, not main() outside uthread_run().
+//
+struct uchan*
+uchan_new(int cap)
+{
+  struct uchan *c;
+
+  if(cap < 1)
+    cap = 1;
+  if((c = malloc(sizeof(*c))) == 0)
+    return 0;
+  if((c->buf = malloc(cap * sizeof(uint64))) == 0){
+    free(c);
+    return 0;
+  }
+  memset(&c->senders, 0, sizeof(c->senders));
+  memset(&c->receivers, 0, sizeof(c->receivers));
+  c->cap = cap;
+  c->head = 0;
+  c->n = 0;
+  return c;
+}
+
+void
+uchan_free(struct uchan *c)
+{
+  free(c->buf);
+  free(c);
+}
+
+void
+uchan_send(struct uchan *c, uint64 v)
+{
+  while(c->n == c->cap)
+    block(&c->senders);
+  c->buf[(c->head + c->n) % c->cap] = v;
+  c->n++;
+  wake(&c->receivers);
+}
+
+uint64
+uchan_recv(struct uchan *c)
+{
+  uint64 v;
+
+  while(c->n == 0)
+    block(&c->receivers);
+  v = c->buf[c->head];
+  c->head = (c->head + 1) % c->cap;
+  c->n--;
+  wake(&c->senders);
+  return v;
+}
@@ -0,0 +1,151 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+// Message round trips between nconn client/server pairs,
+// as green threads over channels and as forked processes
+// over pipes. Each client sends NROUND messages and waits
+// for each echo.
+//   uthreadbench [nconn]
+
+#define NCONN  16
+#define NROUND 2000
+
+int nconn = NCONN;
+
+// mtime, which the kernel lets user code read; uptime()
+// ticks are far too coarse for a round trip.
+uint64
+rdtime(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x));
+  return x;
+}
+
+struct conn {
+  struct uchan *req;
+  struct uchan *resp;
+};
+
+void
+server(void *arg)
+{
+  struct conn *c = arg;
+
+  for(int i = 0; i < NROUND; i++)
+    uchan_send(c->resp, uchan_recv(c->req));
+}
+
+void
+client(void *arg)
+{
+  struct conn *c = arg;
+
+  for(int i = 0; i < NROUND; i++){
+    uchan_send(c->req, i);
+    if(uchan_recv(c->resp) != i){
+      printf("uthreadbench: bad echo\n");
+      exit(1);
+    }
+  }
+}
+
+uint64
+green(void)
+{
+  struct conn *conns;
+  uint64 start;
+  int i;
+
+  start = rdtime();
+  conns = malloc(nconn * sizeof(struct conn));
+  for(i = 0; i < nconn; i++){
+    conns[i].req = uchan_new(1);
+    conns[i].resp = uchan_new(1);
+    if(conns[i].req == 0 || conns[i].resp == 0 ||
+       uthread_create(server, &conns[i]) < 0 || uthread_create(client, &conns[i]) < 0){
+      printf("uthreadbench: out of memory\n");
+      exit(1);
+    }
+  }
+  if(uthread_run() != 0){
+    printf("uthreadbench: deadlock\n");
+    exit(1);
+  }
+  for(i = 0; i < nconn; i++){
+    uchan_free(conns[i].req);
+    uchan_free(conns[i].resp);
+  }
+  free(conns);
+  return rdtime() - start;
+}
+
+uint64
+forked(void)
+{
+  int req[2], resp[2], i, v, n, pid;
+  uint64 start;
+
+  start = rdtime();
+  for(n = 0; n < nconn; n++){
+    if(pipe(req) < 0 || pipe(resp) < 0){
+      printf("uthreadbench: pipe failed\n");
+      exit(1);
+    }
+    if((pid = fork()) == 0){
+      close(req[1]);
+      close(resp[0]);
+      for(i = 0; i < NROUND && read(req[0], &v, sizeof(v)) == sizeof(v); i++)
+        write(resp[1], &v, sizeof(v));
+      exit(0);
+    }
+    if(pid > 0 && (pid = fork()) == 0){
+      close(req[0]);
+      close(resp[1]);
+      for(i = 0; i < NROUND; i++){
+        write(req[1], &i, sizeof(i));
+        if(read(resp[0], &v, sizeof(v)) != sizeof(v) || v != i){
+          printf("uthreadbench: bad echo\n");
+          exit(1);
+        }
+      }
+      exit(0);
+    }
+    if(pid < 0){
+      printf("uthreadbench: fork failed\n");
+      exit(1);
+    }
+    close(req[0]);
+    close(req[1]);
+    close(resp[0]);
+    close(resp[1]);
+  }
+  for(n = 0; n < 2 * nconn; n++)
+    wait(0);
+  return rdtime() - start;
+}
+
+// Print the time t, in mtime cycles, per round trip.
+void
+report(char *what, uint64 t)
+{
+  uint64 n = (uint64)nconn * NROUND;
+
+  printf("%s: %d round trips in %d ms, %d ns each\n", what, (int)n,
+         (int)(t / (MTIME_HZ / 1000)), (int)(t * (1000000000 / MTIME_HZ) / n));
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc > 1)
+    nconn = atoi(argv[1]);
+  if(nconn < 1)
+    nconn = 1;
+
+  report("green threads", green());
+  report("fork+pipe", forked());
+  exit(0);
+}